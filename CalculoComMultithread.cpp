@@ -7,6 +7,26 @@
 #include <cmath>
 #include <limits> // Para inicializar min/max com seguranca
 #include <sstream> // Necessario para processar a linha de entrada
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <iomanip>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TEM_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h> // __cpuid, __cpuidex, _xgetbv
+#endif
+#endif
+
+#include "FilaLimitada.hpp"
 
 // === VARIAVEIS GLOBAIS ===
 // Sero usadas para armazenar os resultados calculados pelas threads.
@@ -66,9 +86,696 @@ void calcular_maximo() {
 }
 
 
+// === KERNEL FUNDIDO (SIMD) ===
+// As tres threads acima leem o vetor inteiro cada uma: tres passadas pela
+// memoria para o trabalho de uma. O kernel fundido calcula soma, minimo e
+// maximo na mesma passada. A soma vai para lanes de 64 bits (cada int e
+// estendido com sinal antes de somar), como o accumulate em long long, entao
+// nao ha risco novo de overflow. Ha versoes AVX2 (8 ints por instrucao),
+// SSE4.1 (4 ints) e escalar; a melhor que o processador suporta e escolhida
+// em tempo de execucao, ou forcada com --kernel.
+
+// Resultado de uma passada (minimo/maximo so fazem sentido com n > 0)
+struct Estatisticas {
+    long long soma;
+    int minimo;
+    int maximo;
+};
+
+Estatisticas resumir_escalar(const int* valores, size_t n) {
+    Estatisticas resultado = {0, std::numeric_limits<int>::max(), std::numeric_limits<int>::min()};
+    for (size_t i = 0; i < n; ++i) {
+        resultado.soma += valores[i];
+        resultado.minimo = std::min(resultado.minimo, valores[i]);
+        resultado.maximo = std::max(resultado.maximo, valores[i]);
+    }
+    return resultado;
+}
+
+#ifdef TEM_SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#define ALVO_SSE41 // O MSVC aceita intrinsicos de qualquer extensao em qualquer funcao
+#define ALVO_AVX2
+#else
+#define ALVO_SSE41 __attribute__((target("sse4.1")))
+#define ALVO_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Junta as lanes de um kernel vetorial com o resultado escalar da sobra
+Estatisticas juntar_lanes(Estatisticas resultado, const long long* somas, int lanes_soma, const int* minimos,
+                          const int* maximos, int lanes) {
+    for (int i = 0; i < lanes_soma; ++i) {
+        resultado.soma += somas[i];
+    }
+    for (int i = 0; i < lanes; ++i) {
+        resultado.minimo = std::min(resultado.minimo, minimos[i]);
+        resultado.maximo = std::max(resultado.maximo, maximos[i]);
+    }
+    return resultado;
+}
+
+ALVO_SSE41 Estatisticas resumir_sse41(const int* valores, size_t n) {
+    __m128i soma = _mm_setzero_si128(); // 2 acumuladores de 64 bits
+    __m128i minimo = _mm_set1_epi32(std::numeric_limits<int>::max());
+    __m128i maximo = _mm_set1_epi32(std::numeric_limits<int>::min());
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(valores + i));
+        // Lanes 0-1 e depois 2-3 (trazidas para baixo) estendidas para 64 bits
+        soma = _mm_add_epi64(soma, _mm_cvtepi32_epi64(v));
+        soma = _mm_add_epi64(soma, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+        minimo = _mm_min_epi32(minimo, v);
+        maximo = _mm_max_epi32(maximo, v);
+    }
+    alignas(16) long long somas[2];
+    alignas(16) int minimos[4];
+    alignas(16) int maximos[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(somas), soma);
+    _mm_store_si128(reinterpret_cast<__m128i*>(minimos), minimo);
+    _mm_store_si128(reinterpret_cast<__m128i*>(maximos), maximo);
+    return juntar_lanes(resumir_escalar(valores + i, n - i), somas, 2, minimos, maximos, 4);
+}
+
+ALVO_AVX2 Estatisticas resumir_avx2(const int* valores, size_t n) {
+    __m256i soma = _mm256_setzero_si256(); // 4 acumuladores de 64 bits
+    __m256i minimo = _mm256_set1_epi32(std::numeric_limits<int>::max());
+    __m256i maximo = _mm256_set1_epi32(std::numeric_limits<int>::min());
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(valores + i));
+        soma = _mm256_add_epi64(soma, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        soma = _mm256_add_epi64(soma, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+        minimo = _mm256_min_epi32(minimo, v);
+        maximo = _mm256_max_epi32(maximo, v);
+    }
+    alignas(32) long long somas[4];
+    alignas(32) int minimos[8];
+    alignas(32) int maximos[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(somas), soma);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(minimos), minimo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(maximos), maximo);
+    return juntar_lanes(resumir_escalar(valores + i, n - i), somas, 4, minimos, maximos, 8);
+}
+
+#if defined(_MSC_VER) && !defined(__clang__)
+bool processador_tem_sse41() {
+    int registradores[4];
+    __cpuid(registradores, 1);
+    return (registradores[2] & (1 << 19)) != 0;
+}
+
+bool processador_tem_avx2() {
+    int registradores[4];
+    __cpuid(registradores, 1);
+    // AVX2 tambem exige que o sistema salve os registradores YMM (OSXSAVE + XCR0)
+    bool avx_com_osxsave = (registradores[2] & (1 << 27)) != 0 && (registradores[2] & (1 << 28)) != 0;
+    if (!avx_com_osxsave || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(registradores, 7, 0);
+    return (registradores[1] & (1 << 5)) != 0;
+}
+#else
+bool processador_tem_sse41() { return __builtin_cpu_supports("sse4.1"); }
+bool processador_tem_avx2() { return __builtin_cpu_supports("avx2"); }
+#endif
+#endif // TEM_SIMD_X86
+
+struct KernelEstatisticas {
+    const char* nome;
+    Estatisticas (*resumir)(const int* valores, size_t n);
+    bool (*suportado)();
+};
+
+bool sempre_suportado() { return true; }
+
+// Do mais rapido para o mais lento: o automatico fica com o primeiro suportado
+const KernelEstatisticas KERNELS[] = {
+#ifdef TEM_SIMD_X86
+    {"avx2", resumir_avx2, processador_tem_avx2},
+    {"sse41", resumir_sse41, processador_tem_sse41},
+#endif
+    {"escalar", resumir_escalar, sempre_suportado},
+};
+
+// Kernel em uso: escolhido por escolher_kernel (o automatico e o padrao)
+const KernelEstatisticas* kernel_ativo = nullptr;
+
+// "auto" escolhe o melhor suportado; um nome escolhe aquele kernel. Devolve
+// false se o nome nao existe ou se o processador nao o suporta.
+bool escolher_kernel(const std::string& nome) {
+    for (const KernelEstatisticas& kernel : KERNELS) {
+        if ((nome == "auto" || nome == kernel.nome) && kernel.suportado()) {
+            kernel_ativo = &kernel;
+            return true;
+        }
+    }
+    return false;
+}
+
+Estatisticas resumir(const int* valores, size_t n) {
+    if (kernel_ativo == nullptr) {
+        escolher_kernel("auto");
+    }
+    return kernel_ativo->resumir(valores, n);
+}
+
+// Versao fundida das tres threads: uma passada na thread atual, resultados
+// nas mesmas variaveis globais
+void calcular_estatisticas_fundidas() {
+    if (dados.empty()) {
+        valor_medio_global = 0.0;
+        valor_minimo_global = 0;
+        valor_maximo_global = 0;
+        return;
+    }
+    Estatisticas resultado = resumir(dados.data(), dados.size());
+    valor_medio_global = static_cast<double>(resultado.soma) / dados.size();
+    valor_minimo_global = resultado.minimo;
+    valor_maximo_global = resultado.maximo;
+}
+
+// === MOTOR DE REDUCAO PARALELA ===
+// Paralelismo por dados em vez de uma thread por estatistica: 'dados' e
+// dividido em blocos de ELEMENTOS_POR_BLOCO, distribuidos entre
+// hardware_concurrency() trabalhadores (a thread-pai e um deles). Cada
+// trabalhador pega o proximo bloco livre num contador atomico, resume-o com
+// o kernel fundido e acumula num parcial {soma, minimo, maximo, contagem}
+// so seu, alinhado a linha de cache para que os trabalhadores nunca
+// escrevam na mesma linha. No fim a thread-pai junta os parciais.
+// Abaixo de LIMIAR_SEQUENCIAL elementos criar threads custa mais que a
+// passada inteira, entao a reducao roda direto na thread atual.
+
+constexpr size_t LINHA_DE_CACHE = 64;
+constexpr size_t ELEMENTOS_POR_BLOCO = 32 * 1024; // 128 KB: cabe folgado na L2 de um nucleo
+constexpr size_t LIMIAR_SEQUENCIAL = 256 * 1024;  // 1 MB: ~0,1 ms de passada com AVX2
+
+struct alignas(LINHA_DE_CACHE) ParcialReducao {
+    Estatisticas estatisticas;
+    size_t contagem;
+};
+
+// Trabalhadores pedidos com --threads (0 = um por nucleo)
+unsigned trabalhadores_pedidos = 0;
+
+Estatisticas juntar_estatisticas(Estatisticas acumulado, const Estatisticas& parcial) {
+    acumulado.soma += parcial.soma;
+    acumulado.minimo = std::min(acumulado.minimo, parcial.minimo);
+    acumulado.maximo = std::max(acumulado.maximo, parcial.maximo);
+    return acumulado;
+}
+
+// Quantos trabalhadores uma reducao de n elementos usa: 1 abaixo do limiar,
+// e nunca mais que o numero de blocos
+unsigned trabalhadores_para(size_t n, unsigned pedidos) {
+    if (pedidos == 0) {
+        pedidos = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (n < LIMIAR_SEQUENCIAL) {
+        return 1;
+    }
+    size_t blocos = (n + ELEMENTOS_POR_BLOCO - 1) / ELEMENTOS_POR_BLOCO;
+    return static_cast<unsigned>(std::min<size_t>(pedidos, blocos));
+}
+
+ParcialReducao reduzir_em_paralelo(const int* valores, size_t n, unsigned pedidos) {
+    // O kernel e resolvido aqui, antes das threads existirem
+    if (kernel_ativo == nullptr) {
+        escolher_kernel("auto");
+    }
+    Estatisticas (*resumir_bloco)(const int*, size_t) = kernel_ativo->resumir;
+    const Estatisticas vazio = {0, std::numeric_limits<int>::max(), std::numeric_limits<int>::min()};
+
+    unsigned trabalhadores = trabalhadores_para(n, pedidos);
+    if (trabalhadores == 1) {
+        ParcialReducao total;
+        total.estatisticas = n > 0 ? resumir_bloco(valores, n) : vazio;
+        total.contagem = n;
+        return total;
+    }
+
+    const size_t blocos = (n + ELEMENTOS_POR_BLOCO - 1) / ELEMENTOS_POR_BLOCO;
+    std::atomic<size_t> proximo_bloco(0);
+    std::vector<ParcialReducao> parciais(trabalhadores);
+    auto trabalhar = [&](ParcialReducao& parcial) {
+        parcial.estatisticas = vazio;
+        parcial.contagem = 0;
+        for (;;) {
+            size_t bloco = proximo_bloco.fetch_add(1, std::memory_order_relaxed);
+            if (bloco >= blocos) {
+                break;
+            }
+            size_t inicio = bloco * ELEMENTOS_POR_BLOCO;
+            size_t tamanho = std::min(ELEMENTOS_POR_BLOCO, n - inicio);
+            parcial.estatisticas = juntar_estatisticas(parcial.estatisticas, resumir_bloco(valores + inicio, tamanho));
+            parcial.contagem += tamanho;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(trabalhadores - 1);
+    for (unsigned t = 1; t < trabalhadores; ++t) {
+        threads.emplace_back(trabalhar, std::ref(parciais[t]));
+    }
+    trabalhar(parciais[0]);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    ParcialReducao total;
+    total.estatisticas = vazio;
+    total.contagem = 0;
+    for (const ParcialReducao& parcial : parciais) {
+        total.estatisticas = juntar_estatisticas(total.estatisticas, parcial.estatisticas);
+        total.contagem += parcial.contagem;
+    }
+    return total;
+}
+
+void calcular_estatisticas_paralelas() {
+    if (dados.empty()) {
+        valor_medio_global = 0.0;
+        valor_minimo_global = 0;
+        valor_maximo_global = 0;
+        return;
+    }
+    ParcialReducao total = reduzir_em_paralelo(dados.data(), dados.size(), trabalhadores_pedidos);
+    valor_medio_global = static_cast<double>(total.estatisticas.soma) / total.contagem;
+    valor_minimo_global = total.estatisticas.minimo;
+    valor_maximo_global = total.estatisticas.maximo;
+}
+
+// === BENCHMARK ===
+// --benchmark [--ate N] [--repeticoes R]: preenche 'dados' com 10^6, 10^7,
+// ... ate N inteiros pseudoaleatorios (faixa inteira do int, para exercitar
+// a soma em 64 bits) e mede a versao de tres threads contra cada kernel
+// suportado, conferindo que todos dao a mesma media, minimo e maximo. Cada
+// tempo e o melhor de R execucoes. GB/s conta os bytes de 'dados' uma vez,
+// mesmo que a versao de tres threads os leia tres vezes. Depois vem a
+// varredura do motor de reducao paralela com o melhor kernel: 1, 2, 4, ...
+// trabalhadores ate --threads-max (padrao: um por nucleo), a curva de
+// escalabilidade de cada tamanho. 10^9 inteiros ocupam 4 GB; se nao
+// couberem na memoria o benchmark para no tamanho anterior.
+
+// Gerador xorshift: bem mais rapido que std::mt19937 para encher 4 GB
+void preencher_dados(size_t n) {
+    dados.resize(n);
+    uint64_t estado = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < n; ++i) {
+        estado ^= estado << 13;
+        estado ^= estado >> 7;
+        estado ^= estado << 17;
+        dados[i] = static_cast<int>(static_cast<uint32_t>(estado >> 32));
+    }
+}
+
+void executar_tres_threads() {
+    std::thread t_media(calcular_media);
+    std::thread t_minimo(calcular_minimo);
+    std::thread t_maximo(calcular_maximo);
+    t_media.join();
+    t_minimo.join();
+    t_maximo.join();
+}
+
+// Melhor tempo (ms) de 'repeticoes' execucoes de 'medir'
+template <typename Funcao>
+double melhor_tempo_ms(int repeticoes, Funcao medir) {
+    double melhor = std::numeric_limits<double>::max();
+    for (int r = 0; r < repeticoes; ++r) {
+        auto inicio = std::chrono::steady_clock::now();
+        medir();
+        auto fim = std::chrono::steady_clock::now();
+        melhor = std::min(melhor, std::chrono::duration<double, std::milli>(fim - inicio).count());
+    }
+    return melhor;
+}
+
+void exibir_linha_benchmark(const std::string& nome, size_t n, double ms, double ms_referencia) {
+    double gb_por_s = static_cast<double>(n) * sizeof(int) / (ms * 1e6);
+    std::cout << "  " << std::left << std::setw(16) << nome << std::right << std::fixed << std::setprecision(2)
+              << std::setw(11) << ms << " ms" << std::setw(9) << gb_por_s << " GB/s" << std::setw(8)
+              << ms_referencia / ms << "x" << std::endl;
+}
+
+int executar_benchmark(int argc, char* argv[]) {
+    size_t maximo = 1000000000;
+    int repeticoes = 3;
+    unsigned threads_maximo = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 2; i < argc; ++i) {
+        std::string opcao = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Falta o valor de " << opcao << std::endl;
+            return 1;
+        }
+        const char* valor = argv[++i];
+        if (opcao == "--ate") {
+            maximo = static_cast<size_t>(std::max(1000000.0, std::atof(valor)));
+        } else if (opcao == "--repeticoes") {
+            repeticoes = std::max(1, std::atoi(valor));
+        } else if (opcao == "--threads-max") {
+            threads_maximo = static_cast<unsigned>(std::max(1, std::atoi(valor)));
+        } else {
+            std::cerr << "Opcao desconhecida: " << opcao << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "=== Benchmark: tres threads x kernel fundido x reducao paralela ===" << std::endl;
+    std::cout << "Kernels suportados:";
+    for (const KernelEstatisticas& kernel : KERNELS) {
+        if (kernel.suportado()) {
+            std::cout << " " << kernel.nome;
+        }
+    }
+    std::cout << " | nucleos: " << std::thread::hardware_concurrency() << std::endl;
+
+    for (size_t n = 1000000; n <= maximo; n *= 10) {
+        try {
+            preencher_dados(n);
+        } catch (const std::bad_alloc&) {
+            std::cout << "\n" << n << " inteiros nao cabem na memoria; benchmark encerrado." << std::endl;
+            break;
+        }
+        std::cout << "\nn = " << n << " (" << n * sizeof(int) / (1024 * 1024) << " MB)" << std::endl;
+
+        double ms_referencia = melhor_tempo_ms(repeticoes, executar_tres_threads);
+        double media_referencia = valor_medio_global;
+        int minimo_referencia = valor_minimo_global;
+        int maximo_referencia = valor_maximo_global;
+        exibir_linha_benchmark("tres threads", n, ms_referencia, ms_referencia);
+
+        for (const KernelEstatisticas& kernel : KERNELS) {
+            if (!kernel.suportado()) {
+                continue;
+            }
+            kernel_ativo = &kernel;
+            double ms = melhor_tempo_ms(repeticoes, calcular_estatisticas_fundidas);
+            exibir_linha_benchmark(std::string("fundido ") + kernel.nome, n, ms, ms_referencia);
+            if (valor_medio_global != media_referencia || valor_minimo_global != minimo_referencia ||
+                valor_maximo_global != maximo_referencia) {
+                std::cerr << "ERRO: o kernel " << kernel.nome << " diverge da versao de tres threads" << std::endl;
+                return 1;
+            }
+        }
+        kernel_ativo = nullptr;
+
+        // Varredura de threads: potencias de 2 e o proprio maximo
+        std::vector<unsigned> contagens_de_threads;
+        for (unsigned threads = 1; threads < threads_maximo; threads *= 2) {
+            contagens_de_threads.push_back(threads);
+        }
+        contagens_de_threads.push_back(threads_maximo);
+        for (unsigned threads : contagens_de_threads) {
+            trabalhadores_pedidos = threads;
+            double ms = melhor_tempo_ms(repeticoes, calcular_estatisticas_paralelas);
+            exibir_linha_benchmark("paralelo " + std::to_string(trabalhadores_para(n, threads)) + "t", n, ms,
+                                   ms_referencia);
+            if (valor_medio_global != media_referencia || valor_minimo_global != minimo_referencia ||
+                valor_maximo_global != maximo_referencia) {
+                std::cerr << "ERRO: a reducao com " << threads << " threads diverge da versao de tres threads"
+                          << std::endl;
+                return 1;
+            }
+        }
+        trabalhadores_pedidos = 0;
+        kernel_ativo = nullptr;
+    }
+    return 0;
+}
+
+
+// === MODO FLUXO (MEMORIA CONSTANTE) ===
+// --fluxo [arquivo] [--eco]: le stdin (ou o arquivo) em blocos de
+// BYTES_POR_LEITURA com fread, sem getline, stringstream nem locale, e
+// nunca guarda a entrada inteira: a memoria usada e a mesma para 1 KB ou
+// 100 GB de numeros. Duas threads trabalham em paralelo:
+//   - a leitora converte os bytes em inteiros (LeitorDeInteiros) e enche
+//     lotes de NUMEROS_POR_LOTE;
+//   - a thread-pai resume cada lote cheio com o kernel fundido e junta ao
+//     acumulado, enquanto a leitora ja enche o outro lote.
+// Sao so dois lotes (buffer duplo), que circulam por duas FilaLimitada:
+// 'cheios' da leitora para a thread-pai e 'vazios' de volta. O eco dos
+// numeros agora e opcional (--eco). A soma continua em long long: so
+// estouraria depois de uns 4 bilhoes de valores perto do limite do int.
+
+constexpr size_t BYTES_POR_LEITURA = 1 << 20; // 1 MB por fread
+constexpr size_t NUMEROS_POR_LOTE = 64 * 1024;
+
+using FilaDeLotes = FilaLimitada<std::vector<int>, 2>;
+
+// Conversor de texto para int, incremental: um numero cortado no fim de um
+// bloco continua no bloco seguinte. Sequencias de digitos, com '-' ou '+'
+// logo antes, sao numeros; qualquer outro byte e separador. Numeros fora da
+// faixa do int sao descartados e contados.
+class LeitorDeInteiros {
+public:
+    // Converte bytes[0, tamanho) acrescentando numeros a 'saida' ate ela
+    // atingir a capacidade. Devolve quantos bytes consumiu: menos que
+    // 'tamanho' so quando 'saida' encheu.
+    size_t consumir(const char* bytes, size_t tamanho, std::vector<int>& saida) {
+        for (size_t i = 0; i < tamanho; ++i) {
+            unsigned digito = static_cast<unsigned char>(bytes[i]) - '0';
+            if (digito < 10) {
+                if (!em_numero) {
+                    em_numero = true;
+                    negativo = sinal_negativo;
+                    valor = 0;
+                }
+                // Depois de passar do limite o valor para de crescer (sem
+                // estourar o uint64_t); so interessa que esta fora da faixa
+                if (valor <= LIMITE_NEGATIVO) {
+                    valor = valor * 10 + digito;
+                }
+                continue;
+            }
+            if (em_numero) {
+                if (saida.size() == saida.capacity()) {
+                    return i; // O byte i fecha o numero na proxima chamada
+                }
+                fechar_numero(saida);
+            }
+            sinal_negativo = bytes[i] == '-';
+        }
+        return tamanho;
+    }
+
+    // Fim da entrada: fecha o ultimo numero, se houver (saida precisa de
+    // espaco para mais um). False se nao havia numero pendente.
+    bool terminar(std::vector<int>& saida) {
+        if (!em_numero) {
+            return false;
+        }
+        fechar_numero(saida);
+        return true;
+    }
+
+    bool numero_pendente() const { return em_numero; }
+    unsigned long long fora_da_faixa() const { return descartados; }
+
+private:
+    static constexpr uint64_t LIMITE_NEGATIVO = 2147483648ULL; // |INT_MIN|
+
+    void fechar_numero(std::vector<int>& saida) {
+        em_numero = false;
+        sinal_negativo = false;
+        if (negativo ? valor > LIMITE_NEGATIVO : valor >= LIMITE_NEGATIVO) {
+            ++descartados;
+            return;
+        }
+        saida.push_back(negativo ? static_cast<int>(-static_cast<int64_t>(valor)) : static_cast<int>(valor));
+    }
+
+    uint64_t valor = 0;
+    bool em_numero = false;
+    bool negativo = false;
+    bool sinal_negativo = false; // O ultimo separador foi um '-'
+    unsigned long long descartados = 0;
+};
+
+// Thread leitora: le 'entrada' ate o fim, enche lotes vazios e os passa
+// para a thread-pai. Fecha 'cheios' no fim (ou num erro de leitura).
+void ler_em_lotes(std::FILE* entrada, FilaDeLotes& vazios, FilaDeLotes& cheios, LeitorDeInteiros& leitor,
+                  unsigned long long& bytes_lidos, bool& erro_de_leitura) {
+    std::vector<char> bloco(BYTES_POR_LEITURA);
+    std::vector<int> lote;
+    if (!vazios.retirar(lote)) {
+        cheios.fechar();
+        return;
+    }
+    for (;;) {
+        size_t lidos = std::fread(bloco.data(), 1, bloco.size(), entrada);
+        bytes_lidos += lidos;
+        size_t posicao = 0;
+        while (posicao < lidos) {
+            posicao += leitor.consumir(bloco.data() + posicao, lidos - posicao, lote);
+            if (lote.size() == lote.capacity()) {
+                cheios.inserir(std::move(lote));
+                vazios.retirar(lote);
+            }
+        }
+        if (lidos < bloco.size()) {
+            erro_de_leitura = std::ferror(entrada) != 0;
+            break;
+        }
+    }
+    if (leitor.numero_pendente() && lote.size() == lote.capacity()) {
+        cheios.inserir(std::move(lote));
+        vazios.retirar(lote);
+    }
+    leitor.terminar(lote);
+    if (!lote.empty()) {
+        cheios.inserir(std::move(lote));
+    }
+    cheios.fechar();
+}
+
+// Acrescenta o lote ao eco: texto montado num buffer e escrito de uma vez
+void ecoar_lote(const std::vector<int>& lote, std::string& texto, bool& primeiro) {
+    texto.clear();
+    char numero[16];
+    for (int valor : lote) {
+        int tamanho = std::snprintf(numero, sizeof(numero), primeiro ? "%d" : " %d", valor);
+        texto.append(numero, static_cast<size_t>(tamanho));
+        primeiro = false;
+    }
+    std::fwrite(texto.data(), 1, texto.size(), stdout);
+}
+
+int executar_fluxo(int argc, char* argv[]) {
+    const char* caminho = nullptr;
+    bool eco = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string opcao = argv[i];
+        if (opcao == "--eco") {
+            eco = true;
+        } else if (opcao == "--kernel" && i + 1 < argc) {
+            std::string nome = argv[++i];
+            if (!escolher_kernel(nome)) {
+                std::cerr << "Kernel invalido ou nao suportado por este processador: " << nome << std::endl;
+                return 1;
+            }
+        } else if (caminho == nullptr && opcao.compare(0, 2, "--") != 0) {
+            caminho = argv[i];
+        } else {
+            std::cerr << "Opcao desconhecida: " << opcao << std::endl;
+            return 1;
+        }
+    }
+
+    std::FILE* entrada = stdin;
+    if (caminho != nullptr) {
+        entrada = std::fopen(caminho, "rb");
+        if (entrada == nullptr) {
+            std::cerr << "ERRO: nao foi possivel abrir " << caminho << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+    if (kernel_ativo == nullptr) {
+        escolher_kernel("auto");
+    }
+
+    // Os dois lotes do buffer duplo: alocados aqui e so reciclados depois
+    FilaDeLotes vazios;
+    FilaDeLotes cheios;
+    for (size_t i = 0; i < FilaDeLotes::capacidade(); ++i) {
+        std::vector<int> lote;
+        lote.reserve(NUMEROS_POR_LOTE);
+        vazios.inserir(std::move(lote));
+    }
+
+    LeitorDeInteiros leitor;
+    unsigned long long bytes_lidos = 0;
+    bool erro_de_leitura = false;
+    auto inicio = std::chrono::steady_clock::now();
+    std::thread leitora(ler_em_lotes, entrada, std::ref(vazios), std::ref(cheios), std::ref(leitor),
+                        std::ref(bytes_lidos), std::ref(erro_de_leitura));
+
+    Estatisticas acumulado = {0, std::numeric_limits<int>::max(), std::numeric_limits<int>::min()};
+    unsigned long long contagem = 0;
+    std::string texto_eco;
+    bool primeiro_eco = true;
+    std::vector<int> lote;
+    while (cheios.retirar(lote)) {
+        acumulado = juntar_estatisticas(acumulado, kernel_ativo->resumir(lote.data(), lote.size()));
+        contagem += lote.size();
+        if (eco) {
+            ecoar_lote(lote, texto_eco, primeiro_eco);
+        }
+        lote.clear();
+        vazios.inserir(std::move(lote));
+    }
+    leitora.join();
+    double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+    if (caminho != nullptr) {
+        std::fclose(entrada);
+    }
+    if (eco && !primeiro_eco) {
+        std::fputc('\n', stdout);
+    }
+    std::fflush(stdout);
+
+    if (erro_de_leitura) {
+        std::cerr << "\nERRO: falha ao ler a entrada." << std::endl;
+        return 1;
+    }
+    if (contagem == 0) {
+        std::cerr << "\nERRO: Nenhuma dado valido foi inserido. Por favor, tente novamente." << std::endl;
+        return 1;
+    }
+    std::cout << "\n=== Resultados das Estatisticas (fluxo) ===" << std::endl;
+    std::cout << "Numeros lidos: " << contagem << " (" << bytes_lidos << " bytes em " << std::fixed
+              << std::setprecision(3) << segundos << " s, " << std::setprecision(1)
+              << bytes_lidos / (segundos * 1e6) << " MB/s)" << std::endl;
+    if (leitor.fora_da_faixa() > 0) {
+        std::cout << "Ignorados por estarem fora da faixa do int: " << leitor.fora_da_faixa() << std::endl;
+    }
+    std::cout << "O valor medio e " << static_cast<long long>(std::llround(static_cast<double>(acumulado.soma) / contagem))
+              << std::endl;
+    std::cout << "O valor minimo e " << acumulado.minimo << std::endl;
+    std::cout << "O valor maximo e " << acumulado.maximo << std::endl;
+    std::cout << "Memoria dos buffers: " << (BYTES_POR_LEITURA + 2 * NUMEROS_POR_LOTE * sizeof(int)) / 1024
+              << " KB (kernel " << kernel_ativo->nome << ")" << std::endl;
+    std::cout << "===========================================" << std::endl;
+    return 0;
+}
+
 // === FUNCAO PRINCIPAL (THREAD-PAI) ===
-// A thread principal agora ignora argc/argv e usa cin para obter os dados.
-int main() {
+// Sem opcoes, le os numeros de cin e calcula as estatisticas com o motor de
+// reducao paralela (que roda o kernel fundido numa unica thread quando a
+// entrada e pequena). Opcoes:
+//   --tres-threads    usa a versao original, uma thread por estatistica
+//   --kernel NOME     forca o kernel (auto, avx2, sse41 ou escalar)
+//   --threads N       trabalhadores do motor (padrao: um por nucleo)
+//   --benchmark ...   compara as duas versoes (ver executar_benchmark)
+//   --fluxo ...       entrada de qualquer tamanho em memoria constante (ver
+//                     executar_fluxo)
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::string(argv[1]) == "--benchmark") {
+        return executar_benchmark(argc, argv);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--fluxo") {
+        return executar_fluxo(argc, argv);
+    }
+    bool tres_threads = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string opcao = argv[i];
+        if (opcao == "--tres-threads") {
+            tres_threads = true;
+        } else if (opcao == "--kernel" && i + 1 < argc) {
+            std::string nome = argv[++i];
+            if (!escolher_kernel(nome)) {
+                std::cerr << "Kernel invalido ou nao suportado por este processador: " << nome << std::endl;
+                return 1;
+            }
+        } else if (opcao == "--threads" && i + 1 < argc) {
+            trabalhadores_pedidos = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            std::cerr << "Opcao desconhecida: " << opcao << std::endl;
+            return 1;
+        }
+    }
+
     std::cout << "=== Calculo de Estatisticas com Multiplos Threads ===" << std::endl;
     std::cout << "-----------------------------------------------------" << std::endl;
     
@@ -101,22 +808,30 @@ int main() {
     }
     std::cout << std::endl;
 
-    // 2. Criacao e Disparo das Threads
-    
-    // Cada thread comeca sua execucao imediatamente e em paralelo.
-    std::thread t_media(calcular_media); 
-    std::thread t_minimo(calcular_minimo);
-    std::thread t_maximo(calcular_maximo);
+    if (tres_threads) {
+        // 2. Criacao e Disparo das Threads
+        
+        // Cada thread comeca sua execucao imediatamente e em paralelo.
+        std::thread t_media(calcular_media); 
+        std::thread t_minimo(calcular_minimo);
+        std::thread t_maximo(calcular_maximo);
 
-    std::cout << "Threads de trabalho criadas. Esperando finalizacao..." << std::endl;
+        std::cout << "Threads de trabalho criadas. Esperando finalizacao..." << std::endl;
 
-    // 3. Sincronizacao: Aguarda a Finalizacao das Threads (join)
-    
-    // A funcao join() bloqueia o thread principal (main) ate que o thread filho
-    // termine sua execucao. Isso e a chave para a sincronizacao neste exemplo.
-    t_media.join();
-    t_minimo.join();
-    t_maximo.join();
+        // 3. Sincronizacao: Aguarda a Finalizacao das Threads (join)
+        
+        // A funcao join() bloqueia o thread principal (main) ate que o thread filho
+        // termine sua execucao. Isso e a chave para a sincronizacao neste exemplo.
+        t_media.join();
+        t_minimo.join();
+        t_maximo.join();
+    } else {
+        // 2-3. Reducao por blocos entre os trabalhadores (ou uma unica
+        // passada na propria thread-pai, se a entrada for pequena)
+        calcular_estatisticas_paralelas();
+        std::cout << "Estatisticas calculadas com " << trabalhadores_para(dados.size(), trabalhadores_pedidos)
+                  << " trabalhador(es) (kernel " << kernel_ativo->nome << ")." << std::endl;
+    }
 
     // 4. Exibicao dos Resultados pelo Thread-Pai (Apos a sincronizacao)
     std::cout << "\n=== Resultados das Estatisticas ===" << std::endl;
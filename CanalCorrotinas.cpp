@@ -0,0 +1,576 @@
+//=============================================================================
+// CANAL COM CORROTINAS (C++20)
+// O produtor-consumidor sem uma thread por participante: produtores e
+// consumidores sao corrotinas que suspendem em
+//     co_await canal.enviar(x)    (canal cheio)
+//     co_await canal.receber()    (canal vazio)
+// e um executor pequeno as retoma em 1 thread, ou em N threads com uma fila
+// de execucao por thread. Dez mil produtores viram dez mil quadros de
+// corrotina (centenas de bytes cada) em vez de dez mil pilhas de thread.
+//
+// Compilar com C++20:  g++ -std=c++20 -O2 -pthread CanalCorrotinas.cpp
+//
+// Uso: CanalCorrotinas [--produtores N] [--itens-por-produtor N]
+//                      [--consumidores N] [--executores N] [--sem-threads]
+// Compara, com os mesmos parametros, corrotinas (1 executor e N executores)
+// contra uma thread por produtor numa FilaLimitada (FilaLimitada.hpp):
+// vazao, memoria por produtor e latencia de entrega (envio -> recepcao).
+//=============================================================================
+
+#include <iostream>
+#include <coroutine>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <system_error>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+#include "FilaLimitada.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>     // GetProcessMemoryInfo
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>    // sysconf
+#endif
+
+// Relogio monotonico, em ns
+inline int64_t agora_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Memoria do processo em KB: residente (paginas de fato em uso) e virtual
+// (reservada, inclui as pilhas inteiras das threads)
+struct MemoriaProcesso {
+    long long residente_kb;
+    long long virtual_kb;
+};
+
+MemoriaProcesso medir_memoria() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS_EX contadores;
+    GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&contadores),
+                         sizeof(contadores));
+    return {static_cast<long long>(contadores.WorkingSetSize / 1024),
+            static_cast<long long>(contadores.PrivateUsage / 1024)};
+#else
+    long long paginas_virtuais = 0, paginas_residentes = 0;
+    if (FILE* arquivo = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(arquivo, "%lld %lld", &paginas_virtuais, &paginas_residentes) != 2) {
+            paginas_virtuais = paginas_residentes = 0;
+        }
+        std::fclose(arquivo);
+    }
+    long long kb_por_pagina = sysconf(_SC_PAGESIZE) / 1024;
+    return {paginas_residentes * kb_por_pagina, paginas_virtuais * kb_por_pagina};
+#endif
+}
+
+// === EXECUTOR ===
+// Cada thread do executor tem a sua fila de corrotinas prontas. Uma
+// corrotina fica presa a fila em que foi lancada: quem a acorda (o canal)
+// a devolve para aquela fila, mesmo estando em outra thread.
+struct FilaExecucao {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::coroutine_handle<>> prontas;
+};
+
+// Fila da thread do executor que esta rodando (nula fora do executor)
+thread_local FilaExecucao* fila_da_thread = nullptr;
+
+class Executor;
+
+// Bytes alocados para quadros de corrotina (o "custo de memoria" de cada
+// produtor), contados pelo operator new da promessa
+std::atomic<long long> bytes_em_quadros{0};
+
+// Corrotina lancada no executor. Comeca suspensa (so roda quando o
+// executor a tirar da fila) e o quadro se destroi sozinho ao terminar.
+struct Tarefa {
+    struct promise_type {
+        Executor* executor = nullptr;
+
+        static void* operator new(std::size_t tamanho) {
+            bytes_em_quadros.fetch_add(static_cast<long long>(tamanho), std::memory_order_relaxed);
+            return ::operator new(tamanho);
+        }
+        static void operator delete(void* quadro, std::size_t tamanho) {
+            bytes_em_quadros.fetch_sub(static_cast<long long>(tamanho), std::memory_order_relaxed);
+            ::operator delete(quadro);
+        }
+
+        Tarefa get_return_object() { return Tarefa{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept;
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> corrotina;
+};
+
+class Executor {
+public:
+    explicit Executor(int threads) : filas(std::max(1, threads)) {}
+
+    // Poe a corrotina na fila de uma das threads (rodizio); so comeca a
+    // rodar em executar()
+    void lancar(Tarefa tarefa) {
+        tarefa.corrotina.promise().executor = this;
+        vivas.fetch_add(1, std::memory_order_relaxed);
+        FilaExecucao& fila = filas[proxima_fila++ % filas.size()];
+        std::lock_guard<std::mutex> lock(fila.mtx);
+        fila.prontas.push_back(tarefa.corrotina);
+    }
+
+    // Devolve uma corrotina suspensa a sua fila (chamado por quem a acorda)
+    static void agendar(FilaExecucao* fila, std::coroutine_handle<> corrotina) {
+        bool estava_vazia;
+        {
+            std::lock_guard<std::mutex> lock(fila->mtx);
+            estava_vazia = fila->prontas.empty();
+            fila->prontas.push_back(corrotina);
+        }
+        if (estava_vazia) {
+            fila->cv.notify_one(); // So ha quem acordar se a fila estava vazia
+        }
+    }
+
+    // Roda as corrotinas ate todas terminarem; a thread que chama e a
+    // primeira thread do executor
+    void executar() {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < filas.size(); ++i) {
+            threads.emplace_back([this, i]() { trabalhar(filas[i]); });
+        }
+        trabalhar(filas[0]);
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    void terminou_uma() {
+        if (vivas.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            for (auto& fila : filas) {
+                std::lock_guard<std::mutex> lock(fila.mtx);
+                fila.cv.notify_all();
+            }
+        }
+    }
+
+private:
+    void trabalhar(FilaExecucao& fila) {
+        fila_da_thread = &fila;
+        for (;;) {
+            std::coroutine_handle<> corrotina;
+            {
+                std::unique_lock<std::mutex> lock(fila.mtx);
+                fila.cv.wait(lock, [&]() { return !fila.prontas.empty() || vivas.load() == 0; });
+                if (fila.prontas.empty()) {
+                    break;
+                }
+                corrotina = fila.prontas.front();
+                fila.prontas.pop_front();
+            }
+            corrotina.resume(); // Roda ate o proximo co_await que suspender (ou o fim)
+        }
+        fila_da_thread = nullptr;
+    }
+
+    std::vector<FilaExecucao> filas;
+    size_t proxima_fila = 0;
+    std::atomic<long> vivas{0};
+};
+
+inline std::suspend_never Tarefa::promise_type::final_suspend() noexcept {
+    executor->terminou_uma();
+    return {};
+}
+
+// === CANAL ===
+// Canal limitado de T entre corrotinas. As esperas nao bloqueiam threads:
+// quem nao pode seguir guarda o proprio awaiter (que vive no quadro da
+// corrotina) na lista de espera e suspende; quem libera a condicao faz a
+// transferencia e agenda a corrotina de volta no executor dela.
+//   - envio com recepcao esperando: o valor vai direto para ela;
+//   - envio com espaco no buffer: entra no buffer e segue sem suspender;
+//   - recepcao com buffer cheio e envios esperando: o primeiro envio
+//     esperando entra no buffer no lugar do item retirado.
+// Tudo sob um mutex, para funcionar com varias threads de executor.
+template <typename T>
+class Canal {
+public:
+    explicit Canal(size_t capacidade) : capacidade(capacidade) {}
+
+    struct Envio {
+        Envio(Canal& canal, T valor) : canal(canal), valor(std::move(valor)) {}
+
+        Canal& canal;
+        T valor;
+        std::coroutine_handle<> corrotina;
+        FilaExecucao* fila = nullptr;
+        bool aceito = true;
+
+        bool await_ready() const noexcept { return false; }
+        // true = suspende; false = segue sem suspender (ja entregou)
+        bool await_suspend(std::coroutine_handle<> h) {
+            corrotina = h;
+            fila = fila_da_thread;
+            return canal.tentar_enviar_ou_esperar(this);
+        }
+        // false se o canal foi fechado antes do valor ser entregue
+        bool await_resume() const noexcept { return aceito; }
+    };
+
+    struct Recepcao {
+        explicit Recepcao(Canal& canal) : canal(canal) {}
+
+        Canal& canal;
+        std::optional<T> resultado;
+        std::coroutine_handle<> corrotina;
+        FilaExecucao* fila = nullptr;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) {
+            corrotina = h;
+            fila = fila_da_thread;
+            return canal.tentar_receber_ou_esperar(this);
+        }
+        // Vazio quando o canal foi fechado e esvaziado
+        std::optional<T> await_resume() { return std::move(resultado); }
+    };
+
+    Envio enviar(T valor) { return Envio(*this, std::move(valor)); }
+    Recepcao receber() { return Recepcao(*this); }
+
+    // Recepcoes pendentes acordam vazias; envios pendentes, com false
+    void fechar() {
+        std::lock_guard<std::mutex> lock(mtx);
+        fechado = true;
+        for (Recepcao* recepcao : recepcoes_esperando) {
+            Executor::agendar(recepcao->fila, recepcao->corrotina);
+        }
+        for (Envio* envio : envios_esperando) {
+            envio->aceito = false;
+            Executor::agendar(envio->fila, envio->corrotina);
+        }
+        recepcoes_esperando.clear();
+        envios_esperando.clear();
+    }
+
+private:
+    bool tentar_enviar_ou_esperar(Envio* envio) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (fechado) {
+            envio->aceito = false;
+            return false;
+        }
+        if (!recepcoes_esperando.empty()) {
+            Recepcao* recepcao = recepcoes_esperando.front();
+            recepcoes_esperando.pop_front();
+            recepcao->resultado = std::move(envio->valor);
+            Executor::agendar(recepcao->fila, recepcao->corrotina);
+            return false;
+        }
+        if (buffer.size() < capacidade) {
+            buffer.push_back(std::move(envio->valor));
+            return false;
+        }
+        envios_esperando.push_back(envio);
+        return true;
+    }
+
+    bool tentar_receber_ou_esperar(Recepcao* recepcao) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!buffer.empty()) {
+            recepcao->resultado = std::move(buffer.front());
+            buffer.pop_front();
+            if (!envios_esperando.empty()) {
+                Envio* envio = envios_esperando.front();
+                envios_esperando.pop_front();
+                buffer.push_back(std::move(envio->valor));
+                Executor::agendar(envio->fila, envio->corrotina);
+            }
+            return false;
+        }
+        if (!envios_esperando.empty()) { // Capacidade 0: entrega direta
+            Envio* envio = envios_esperando.front();
+            envios_esperando.pop_front();
+            recepcao->resultado = std::move(envio->valor);
+            Executor::agendar(envio->fila, envio->corrotina);
+            return false;
+        }
+        if (fechado) {
+            return false;
+        }
+        recepcoes_esperando.push_back(recepcao);
+        return true;
+    }
+
+    size_t capacidade;
+    std::deque<T> buffer;
+    std::deque<Envio*> envios_esperando;
+    std::deque<Recepcao*> recepcoes_esperando;
+    bool fechado = false;
+    std::mutex mtx;
+};
+
+// === BENCHMARK ===
+struct Item {
+    int produtor;
+    int64_t enviado_ns;
+};
+
+const size_t CAPACIDADE_CANAL = 1024;
+
+struct ConfiguracaoBenchmark {
+    int produtores;
+    int itens_por_produtor;
+    int consumidores;
+    int executores;
+};
+
+struct ResultadoModelo {
+    double itens_por_segundo;
+    double bytes_por_produtor;      // Quadro de corrotina (exato); 0 para threads
+    double residente_por_produtor;  // Aumento da memoria residente / produtor, em bytes
+    double virtual_por_produtor;    // Aumento da memoria virtual / produtor, em bytes
+    int produtores_criados;
+    std::vector<int64_t> latencias; // Envio -> recepcao de cada item, em ns
+    bool correto;
+};
+
+// Percentil de um vetor ja ordenado, em us
+static double percentil_us(const std::vector<int64_t>& ordenado, double fracao) {
+    if (ordenado.empty()) {
+        return 0;
+    }
+    size_t posicao = std::min(ordenado.size() - 1, static_cast<size_t>(fracao * ordenado.size()));
+    return ordenado[posicao] / 1000.0;
+}
+
+static void exibir_resultado(const char* modelo, ResultadoModelo& r) {
+    std::sort(r.latencias.begin(), r.latencias.end());
+    std::printf(" %-24s %6d prod : %10.0f itens/s | por produtor: quadro %6.0f B, residente %8.0f B,"
+                " virtual %9.0f B\n",
+                modelo, r.produtores_criados, r.itens_por_segundo, r.bytes_por_produtor, r.residente_por_produtor,
+                r.virtual_por_produtor);
+    std::printf(" %-24s latencia de entrega: p50 %9.2f | p99 %9.2f | p99.9 %9.2f | max %9.2f us\n", "",
+                percentil_us(r.latencias, 0.50), percentil_us(r.latencias, 0.99), percentil_us(r.latencias, 0.999),
+                r.latencias.empty() ? 0.0 : r.latencias.back() / 1000.0);
+    std::fflush(stdout);
+}
+
+Tarefa produtor_corrotina(Canal<Item>& canal, int id, int itens, std::atomic<int>& restantes) {
+    for (int i = 0; i < itens; ++i) {
+        co_await canal.enviar(Item{id, agora_ns()});
+    }
+    if (restantes.fetch_sub(1) == 1) {
+        canal.fechar(); // O ultimo produtor encerra o canal
+    }
+}
+
+Tarefa consumidor_corrotina(Canal<Item>& canal, std::vector<int64_t>& latencias, long long& soma_ids) {
+    while (std::optional<Item> item = co_await canal.receber()) {
+        latencias.push_back(agora_ns() - item->enviado_ns);
+        soma_ids += item->produtor;
+    }
+}
+
+// Todas as corrotinas sao criadas (e a memoria medida) antes do executor
+// comecar a rodar
+static ResultadoModelo medir_corrotinas(const ConfiguracaoBenchmark& config, int executores) {
+    ResultadoModelo resultado = {};
+    Canal<Item> canal(CAPACIDADE_CANAL);
+    Executor executor(executores);
+    std::atomic<int> restantes{config.produtores};
+    std::vector<std::vector<int64_t>> latencias(config.consumidores);
+    std::vector<long long> somas(config.consumidores, 0);
+    for (auto& l : latencias) {
+        l.reserve(static_cast<size_t>(config.produtores) * config.itens_por_produtor / config.consumidores + 1);
+    }
+
+    MemoriaProcesso antes = medir_memoria();
+    for (int c = 0; c < config.consumidores; ++c) {
+        executor.lancar(consumidor_corrotina(canal, latencias[c], somas[c]));
+    }
+    long long quadros_consumidores = bytes_em_quadros.load();
+    for (int p = 0; p < config.produtores; ++p) {
+        executor.lancar(produtor_corrotina(canal, p, config.itens_por_produtor, restantes));
+    }
+    MemoriaProcesso depois = medir_memoria();
+    resultado.bytes_por_produtor = static_cast<double>(bytes_em_quadros.load() - quadros_consumidores) /
+                                   config.produtores;
+    resultado.residente_por_produtor = (depois.residente_kb - antes.residente_kb) * 1024.0 / config.produtores;
+    resultado.virtual_por_produtor = (depois.virtual_kb - antes.virtual_kb) * 1024.0 / config.produtores;
+    resultado.produtores_criados = config.produtores;
+
+    auto inicio = std::chrono::steady_clock::now();
+    executor.executar();
+    std::chrono::duration<double> segundos = std::chrono::steady_clock::now() - inicio;
+
+    long long total = static_cast<long long>(config.produtores) * config.itens_por_produtor;
+    long long soma_ids = 0;
+    for (int c = 0; c < config.consumidores; ++c) {
+        soma_ids += somas[c];
+        resultado.latencias.insert(resultado.latencias.end(), latencias[c].begin(), latencias[c].end());
+    }
+    long long soma_esperada = static_cast<long long>(config.produtores) * (config.produtores - 1) / 2 *
+                              config.itens_por_produtor;
+    resultado.correto = static_cast<long long>(resultado.latencias.size()) == total && soma_ids == soma_esperada;
+    resultado.itens_por_segundo = total / segundos.count();
+    return resultado;
+}
+
+// O modelo de hoje: uma thread por produtor e por consumidor, bloqueando
+// numa fila com mutex e variaveis de condicao. Os produtores so comecam
+// depois de todas as threads existirem (para medir a memoria). Se o
+// sistema recusar criar mais threads, roda com as que conseguiu.
+typedef FilaLimitada<Item, CAPACIDADE_CANAL> FilaDeItens;
+
+static ResultadoModelo medir_threads(const ConfiguracaoBenchmark& config) {
+    ResultadoModelo resultado = {};
+    auto fila = std::make_unique<FilaDeItens>();
+    std::vector<std::vector<int64_t>> latencias(config.consumidores);
+    std::vector<long long> somas(config.consumidores, 0);
+    for (auto& l : latencias) {
+        l.reserve(static_cast<size_t>(config.produtores) * config.itens_por_produtor / config.consumidores + 1);
+    }
+    std::mutex mtx_largada;
+    std::condition_variable cv_largada;
+    bool largada = false;
+
+    std::vector<std::thread> consumidores;
+    for (int c = 0; c < config.consumidores; ++c) {
+        consumidores.emplace_back([&, c]() {
+            Item item;
+            while (fila->retirar(item)) {
+                latencias[c].push_back(agora_ns() - item.enviado_ns);
+                somas[c] += item.produtor;
+            }
+        });
+    }
+
+    MemoriaProcesso antes = medir_memoria();
+    std::vector<std::thread> produtores;
+    produtores.reserve(config.produtores);
+    try {
+        for (int p = 0; p < config.produtores; ++p) {
+            produtores.emplace_back([&, p]() {
+                {
+                    std::unique_lock<std::mutex> lock(mtx_largada);
+                    cv_largada.wait(lock, [&]() { return largada; });
+                }
+                for (int i = 0; i < config.itens_por_produtor; ++i) {
+                    fila->inserir(Item{p, agora_ns()});
+                }
+            });
+        }
+    } catch (const std::system_error& erro) {
+        std::cerr << "Aviso: so foi possivel criar " << produtores.size() << " threads (" << erro.what() << ").\n";
+    }
+    MemoriaProcesso depois = medir_memoria();
+    int criados = static_cast<int>(produtores.size());
+    resultado.produtores_criados = criados;
+    resultado.residente_por_produtor = (depois.residente_kb - antes.residente_kb) * 1024.0 / std::max(1, criados);
+    resultado.virtual_por_produtor = (depois.virtual_kb - antes.virtual_kb) * 1024.0 / std::max(1, criados);
+
+    auto inicio = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mtx_largada);
+        largada = true;
+    }
+    cv_largada.notify_all();
+    for (auto& t : produtores) {
+        t.join();
+    }
+    fila->fechar();
+    for (auto& t : consumidores) {
+        t.join();
+    }
+    std::chrono::duration<double> segundos = std::chrono::steady_clock::now() - inicio;
+
+    long long total = static_cast<long long>(criados) * config.itens_por_produtor;
+    long long soma_ids = 0;
+    for (int c = 0; c < config.consumidores; ++c) {
+        soma_ids += somas[c];
+        resultado.latencias.insert(resultado.latencias.end(), latencias[c].begin(), latencias[c].end());
+    }
+    long long soma_esperada = static_cast<long long>(criados) * (criados - 1) / 2 * config.itens_por_produtor;
+    resultado.correto = static_cast<long long>(resultado.latencias.size()) == total && soma_ids == soma_esperada;
+    resultado.itens_por_segundo = total / segundos.count();
+    return resultado;
+}
+
+// === FUNCAO PRINCIPAL ===
+int main(int argc, char* argv[]) {
+    int nucleos = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    ConfiguracaoBenchmark config = {10000, 10, 1, nucleos};
+    bool com_threads = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string opcao = argv[i];
+        if (opcao == "--sem-threads") {
+            com_threads = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Falta o valor de " << opcao << "\n";
+            return 1;
+        }
+        int valor = std::max(1, std::atoi(argv[++i]));
+        if (opcao == "--produtores") {
+            config.produtores = valor;
+        } else if (opcao == "--itens-por-produtor") {
+            config.itens_por_produtor = valor;
+        } else if (opcao == "--consumidores") {
+            config.consumidores = valor;
+        } else if (opcao == "--executores") {
+            config.executores = valor;
+        } else {
+            std::cerr << "Opcao desconhecida: " << opcao << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "========================================================\n";
+    std::cout << " CANAL: CORROTINAS x UMA THREAD POR PRODUTOR\n";
+    std::cout << " Produtores: " << config.produtores << " | Itens por produtor: " << config.itens_por_produtor
+              << " | Consumidores: " << config.consumidores << " | Capacidade: " << CAPACIDADE_CANAL << "\n";
+    std::cout << "========================================================\n";
+
+    bool correto = true;
+    ResultadoModelo um_executor = medir_corrotinas(config, 1);
+    exibir_resultado("corrotinas, 1 executor", um_executor);
+    correto = correto && um_executor.correto;
+    if (config.executores > 1) {
+        ResultadoModelo varios = medir_corrotinas(config, config.executores);
+        std::string nome = "corrotinas, " + std::to_string(config.executores) + " executores";
+        exibir_resultado(nome.c_str(), varios);
+        correto = correto && varios.correto;
+    }
+    if (com_threads) {
+        ResultadoModelo threads = medir_threads(config);
+        exibir_resultado("thread por produtor", threads);
+        correto = correto && threads.correto;
+    }
+    if (!correto) {
+        std::cerr << "ERRO: itens perdidos ou repetidos.\n";
+        return 1;
+    }
+    return 0;
+}
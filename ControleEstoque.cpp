@@ -12,6 +12,40 @@
 // - Busca de produtos por nome
 // - Entrada e saida de mercadorias no estoque
 // - Geracao de relatorio de status do estoque
+// - Catalogo residente em memoria com indice hash por ID (O(1))
+// - Log de movimentacoes (write-ahead log) so de acrescimo, com checkpoint
+//   periodico no arquivo de estoque e reaplicacao na inicializacao
+// - Formato binario de registros fixos (estoque.dat), com atualizacao de um
+//   unico registro no lugar e importacao/exportacao do formato texto
+// - Carga do estoque texto por mapeamento em memoria, sem copias
+// - Busca por trecho do nome com indice invertido de trigramas (sem
+//   diferenciar maiusculas/acentos) e limite de resultados
+// - Modo lote (nao interativo) para aplicar arquivos grandes de movimentacoes:
+//       ControleEstoque --lote movimentos.txt [rejeitados.txt]
+// - Servidor multiusuario: varios terminais/leitores enviam movimentacoes ao
+//   mesmo tempo por um named pipe, com travas por fragmento de produtos:
+//       ControleEstoque --servidor      (console do servidor tambem e sessao)
+//       ControleEstoque --cliente       (terminal ligado ao servidor)
+// - Totais do estoque (quantidade, valor e produtos abaixo do estoque minimo
+//   de cada produto) mantidos a cada movimentacao; resumo do relatorio em
+//   O(1) e conferencia por recalculo completo:
+//       ControleEstoque --verificar
+// - Log de movimentacoes mantido aberto, com modo de durabilidade escolhido
+//   na linha de comando (antes do modo de execucao) e estatisticas de commit:
+//       ControleEstoque --durabilidade nenhuma|movimento|grupo [--janela-ms N] ...
+// - Historico binario de movimentacoes em segmentos diarios, com indice
+//   esparso (periodo e filtro de Bloom dos IDs) para consultas por periodo,
+//   produto e tipo, e conversao do movimentacoes.txt legado:
+//       ControleEstoque --historico [--de DATA] [--ate DATA] [--produto ID] [--tipo TIPO]
+//       ControleEstoque --converter-historico [movimentacoes.txt]
+// - Catalogo em memoria organizado em colunas (ID, quantidade, preco em
+//   centavos, estoque minimo) com os nomes em um pool unico de texto
+// - Totais e selecao de baixo estoque por kernels AVX2 (ou escalares, se a
+//   CPU nao suportar), divididos entre os nucleos:
+//       ControleEstoque --kernel auto|escalar|avx2 ...
+// - Benchmark das operacoes (carga, busca, movimentacao, lote, relatorio e
+//   gravacao) sobre catalogos sinteticos, com p50/p99 e saida CSV/JSON:
+//       ControleEstoque --benchmark [--tamanhos 10000,1000000] [--csv arquivo] ...
 //
 // SYSTEM CALLS UTILIZADAS:
 // - CreateFile: Criacao e abertura de arquivos
@@ -19,6 +53,21 @@
 // - ReadFile: Leitura de dados
 // - CloseHandle: Fechamento de recursos
 // - SetFilePointer: Navegacao dentro do arquivo
+// - GetFileAttributesEx: Tamanho e data de modificacao (recarga do catalogo)
+// - FlushFileBuffers: Forca os dados do checkpoint para o disco
+// - MoveFileEx: Troca atomica do arquivo de estoque no checkpoint
+// - SetEndOfFile: Descarta um registro incompleto no fim do log
+// - WriteFile/ReadFile com OVERLAPPED: Escrita/leitura posicionada (offset)
+// - CreateFileMapping/MapViewOfFile: Mapeamento do arquivo em memoria
+// - CreateNamedPipe/ConnectNamedPipe: Comunicacao local entre processos
+// - OpenProcessToken/ConvertStringSecurityDescriptor: Pipe restrito ao usuario
+//   que iniciou o servidor
+// - FileTimeToLocalFileTime/FileTimeToSystemTime: Data do historico legado
+// - FlushFileBuffers no log: Torna as movimentacoes duraveis (por movimentacao
+//   ou uma vez por grupo de movimentacoes)
+//
+// COMPILACAO: requer C++17 (/std:c++17) por causa de std::from_chars e
+// std::string_view
 //
 // AUTOR: Kojo
 // DISCIPLINA: Sistemas Operacionais
@@ -28,26 +77,851 @@
 #include <string>
 #include <vector>
 #include <windows.h>
+#include <sddl.h>
 #include <stdio.h>
 #include <algorithm> 
 #include <cctype>    
+#include <cstdint>
+#include <charconv>
+#include <string_view>
+#include <unordered_map>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <cmath>
+#include <immintrin.h>
+#include <random>
+#include <climits>
 
 // Definicoes de constantes para limites
 #define MAX_NOME 100
 #define MAX_ARQUIVO 20000 // Tamanho maximo do buffer para leitura de arquivo
 
+// Estoque minimo assumido quando o produto nao define o seu
+const int ESTOQUE_MINIMO_PADRAO = 10;
+
 // Estrutura para representar um produto no estoque
 struct Produto {
     int id;
     char nome[MAX_NOME];
     int quantidade;
     double preco;
+    int estoqueMinimo; // Abaixo deste saldo o produto esta com baixo estoque
+};
+
+// === FORMATO BINARIO DO ESTOQUE (estoque.dat) ===
+// Cabecalho fixo seguido de registros de tamanho fixo. O registro do produto
+// na posicao 'slot' do catalogo fica no offset
+//     TAMANHO_CABECALHO + slot * sizeof(RegistroProduto)
+// e pode ser reescrito sozinho, sem tocar no resto do arquivo.
+const char ASSINATURA_BINARIO[4] = {'E', 'S', 'T', 'Q'};
+// Versao 1: campo final reservado. Versao 2: campo final e o estoque minimo
+// (arquivos da versao 1 sao migrados automaticamente na carga).
+const uint32_t VERSAO_BINARIO = 2;
+
+struct CabecalhoEstoque {
+    char assinatura[4];           // "ESTQ"
+    uint32_t versao;              // VERSAO_BINARIO
+    uint32_t tamanhoRegistro;     // sizeof(RegistroProduto), confere o layout
+    uint32_t reservado;
+    uint64_t quantidadeRegistros; // Registros validos apos o cabecalho
+    uint64_t reservado2;
+};
+
+// Tipos de largura fixa: o layout nao depende do compilador/plataforma
+struct RegistroProduto {
+    int32_t id;
+    int32_t quantidade;
+    double preco;
+    char nome[MAX_NOME];
+    int32_t estoqueMinimo; // Versao 2 (reservado na versao 1)
+};
+
+const DWORD TAMANHO_CABECALHO = sizeof(CabecalhoEstoque);
+static_assert(sizeof(CabecalhoEstoque) == 32, "layout do cabecalho binario mudou");
+static_assert(sizeof(RegistroProduto) == 120, "layout do registro binario mudou");
+
+// === HISTORICO BINARIO DE MOVIMENTACOES ===
+// Um arquivo (segmento) por dia, "historico_AAAAMMDD.hst", com registros de
+// 16 bytes acrescentados no fim. O indice esparso "historico.idx" guarda um
+// resumo por segmento (menor/maior momento e filtro de Bloom dos IDs), entao
+// uma consulta so abre os segmentos que podem ter registros do periodo e do
+// produto pedidos.
+const char ASSINATURA_HISTORICO[4] = {'H', 'I', 'S', 'T'};
+const uint32_t VERSAO_HISTORICO = 1;
+const int BITS_FILTRO_HISTORICO = 2048; // Filtro de Bloom por segmento (256 bytes)
+const int HASHES_FILTRO_HISTORICO = 3;
+
+enum TipoMovimentacao {
+    TIPO_ENTRADA = 1,
+    TIPO_SAIDA = 2,
+    TIPO_MINIMO = 3
+};
+
+struct RegistroHistorico {
+    uint32_t momento;   // Segundos desde 2000-01-01 00:00:00 (hora local)
+    int32_t idProduto;
+    int32_t delta;      // +qtd na ENTRADA, -qtd na SAIDA, novo minimo no MINIMO
+    uint8_t tipo;       // TipoMovimentacao
+    uint8_t reservado[3];
+};
+
+struct CabecalhoIndiceHistorico {
+    char assinatura[4];           // "HIST"
+    uint32_t versao;              // VERSAO_HISTORICO
+    uint32_t tamanhoEntrada;      // sizeof(EntradaIndiceHistorico)
+    uint32_t quantidadeSegmentos; // Entradas validas apos o cabecalho
+};
+
+// Resumo de um segmento no indice esparso
+struct EntradaIndiceHistorico {
+    uint32_t dia;                 // AAAAMMDD, tambem o nome do segmento
+    uint32_t menorMomento;
+    uint32_t maiorMomento;
+    uint32_t quantidadeRegistros;
+    uint64_t filtro[BITS_FILTRO_HISTORICO / 64]; // IDs de produto presentes
+};
+
+static_assert(sizeof(RegistroHistorico) == 16, "layout do registro de historico mudou");
+static_assert(sizeof(CabecalhoIndiceHistorico) == 16, "layout do indice de historico mudou");
+static_assert(sizeof(EntradaIndiceHistorico) == 272, "layout do indice de historico mudou");
+
+// Um produto lido do arquivo texto. O nome e uma visao direta sobre a memoria
+// mapeada (sem copia) e so vale enquanto o arquivo estiver mapeado.
+struct ProdutoMapeado {
+    int id;
+    std::string_view nome;
+    int quantidade;
+    double preco;
+    int estoqueMinimo; // Quinto campo opcional da linha
 };
 
 // Variaveis globais para nomes dos arquivos
 const char* ARQUIVO_ESTOQUE = "estoque.txt";
-const char* ARQUIVO_MOVIMENTACOES = "movimentacoes.txt";
+const char* ARQUIVO_MOVIMENTACOES = "movimentacoes.txt"; // Formato legado (nao e mais gravado)
+const char* ARQUIVO_LOG_MOVIMENTACOES = "movimentacoes.log";
+const char* ARQUIVO_ESTOQUE_TEMP = "estoque.txt.tmp";
+const char* ARQUIVO_ESTOQUE_BINARIO = "estoque.dat";
+const char* ARQUIVO_ESTOQUE_BINARIO_TEMP = "estoque.dat.tmp";
 const char* ARQUIVO_RELATORIO = "relatorio_estoque.txt";
+const char* ARQUIVO_INDICE_HISTORICO = "historico.idx";
+
+// Numero de movimentacoes acumuladas no log antes de um checkpoint
+const int LIMITE_CHECKPOINT = 1000;
+
+// Pipe local usado pelo modo servidor/cliente
+const char* NOME_PIPE = "\\\\.\\pipe\\controle_estoque";
+
+// Numero de fragmentos de trava (potencia de 2). Produtos em fragmentos
+// diferentes podem ser movimentados ao mesmo tempo.
+const int NUM_FRAGMENTOS = 64;
+
+// Preco em centavos (inteiro): os totais de valor nao acumulam erro de double
+static long long precoEmCentavos(double preco) {
+    return std::llround(preco * 100.0);
+}
+
+// A coluna de precos guarda centavos em int32_t: fora de +-R$ 21.474.836,47
+// o preco nao cabe. Esses precos sao recusados no cadastro e na carga, em vez
+// de truncados (o valor truncado voltaria para o arquivo no proximo save).
+static bool precoCabeNaColuna(double preco) {
+    double centavos = preco * 100.0; // NaN falha nas duas comparacoes
+    return centavos > INT32_MIN - 0.5 && centavos < INT32_MAX + 0.5;
+}
+
+// === CATALOGO COLUNAR ===
+// Em memoria os produtos ficam em colunas (um vetor contiguo por campo) e nao
+// em um vetor de Produto: a valoracao do estoque ou uma varredura de
+// quantidades so trazem para a cache as colunas que usam, 4 bytes por campo
+// em vez dos ~120 bytes de cada Produto. O preco e guardado em centavos
+// (ponto fixo). Os nomes ficam todos em um unico pool de texto (terminados em
+// '\0') e cada produto guarda apenas o offset do seu nome no pool.
+// O Produto continua sendo o formato de troca: arquivos, cadastro e respostas.
+class ColunasProdutos {
+public:
+    std::vector<int32_t> ids;
+    std::vector<int32_t> quantidades;
+    std::vector<int32_t> precosCentavos;
+    std::vector<int32_t> estoquesMinimos;
+    std::vector<uint32_t> offsetsNomes; // Posicao do nome em poolNomes
+
+    size_t tamanho() const { return ids.size(); }
+    bool vazio() const { return ids.empty(); }
+
+    void reservar(size_t produtos, size_t bytesNomes) {
+        ids.reserve(produtos);
+        quantidades.reserve(produtos);
+        precosCentavos.reserve(produtos);
+        estoquesMinimos.reserve(produtos);
+        offsetsNomes.reserve(produtos);
+        poolNomes.reserve(bytesNomes);
+    }
+
+    void adicionar(int id, std::string_view nome, int quantidade, int32_t precoCentavos, int estoqueMinimo) {
+        nome = nome.substr(0, MAX_NOME - 1); // Mesmo limite do Produto
+        ids.push_back(id);
+        quantidades.push_back(quantidade);
+        precosCentavos.push_back(precoCentavos);
+        estoquesMinimos.push_back(estoqueMinimo);
+        offsetsNomes.push_back(static_cast<uint32_t>(poolNomes.size()));
+        poolNomes.insert(poolNomes.end(), nome.begin(), nome.end());
+        poolNomes.push_back('\0');
+    }
+
+    void adicionar(const Produto& p) {
+        adicionar(p.id, p.nome, p.quantidade, static_cast<int32_t>(precoEmCentavos(p.preco)), p.estoqueMinimo);
+    }
+
+    // Copia o produto da posicao 'origem' para 'destino' (compactacao). O
+    // nome nao e copiado: 'destino' passa a apontar para o mesmo texto.
+    void mover(size_t destino, size_t origem) {
+        ids[destino] = ids[origem];
+        quantidades[destino] = quantidades[origem];
+        precosCentavos[destino] = precosCentavos[origem];
+        estoquesMinimos[destino] = estoquesMinimos[origem];
+        offsetsNomes[destino] = offsetsNomes[origem];
+    }
+
+    void truncar(size_t quantidade) {
+        ids.resize(quantidade);
+        quantidades.resize(quantidade);
+        precosCentavos.resize(quantidade);
+        estoquesMinimos.resize(quantidade);
+        offsetsNomes.resize(quantidade);
+    }
+
+    void trocar(ColunasProdutos& outro) {
+        ids.swap(outro.ids);
+        quantidades.swap(outro.quantidades);
+        precosCentavos.swap(outro.precosCentavos);
+        estoquesMinimos.swap(outro.estoquesMinimos);
+        offsetsNomes.swap(outro.offsetsNomes);
+        poolNomes.swap(outro.poolNomes);
+    }
+
+    const char* nome(size_t slot) const { return poolNomes.data() + offsetsNomes[slot]; }
+    double preco(size_t slot) const { return precosCentavos[slot] / 100.0; }
+
+    // Copia completa de um produto (para arquivos e mensagens)
+    Produto produto(size_t slot) const {
+        Produto p;
+        p.id = ids[slot];
+        strncpy_s(p.nome, nome(slot), MAX_NOME - 1);
+        p.quantidade = quantidades[slot];
+        p.preco = preco(slot);
+        p.estoqueMinimo = estoquesMinimos[slot];
+        return p;
+    }
+
+    // Memoria ocupada pelas colunas e pelo pool de nomes
+    size_t bytesEmUso() const {
+        return tamanho() * (4 * sizeof(int32_t) + sizeof(uint32_t)) + poolNomes.size();
+    }
+
+private:
+    std::vector<char> poolNomes; // Arena de nomes: so cresce (nomes nao mudam)
+};
+
+// === INDICE HASH POR ID ===
+// Tabela de enderecamento aberto (sondagem linear) que mapeia Produto::id para
+// a posicao do produto no vetor do catalogo. A tabela e mantida com no maximo
+// 50% de ocupacao, entao busca e insercao custam O(1) em media.
+class IndiceHashId {
+public:
+    IndiceHashId() : ocupados(0) { tabela.assign(16, Entrada{0, VAZIO}); }
+
+    // Retorna a posicao do produto no catalogo, ou -1 se o id nao existir
+    int buscar(int id) const {
+        size_t mascara = tabela.size() - 1;
+        for (size_t i = hashId(id) & mascara; ; i = (i + 1) & mascara) {
+            if (tabela[i].posicao == VAZIO) return -1;
+            if (tabela[i].id == id) return tabela[i].posicao;
+        }
+    }
+
+    // Insere o par (id, posicao). Retorna false se o id ja estiver no indice.
+    bool inserir(int id, int posicao) {
+        if ((ocupados + 1) * 2 > tabela.size()) {
+            crescer();
+        }
+        size_t mascara = tabela.size() - 1;
+        size_t i = hashId(id) & mascara;
+        while (tabela[i].posicao != VAZIO) {
+            if (tabela[i].id == id) return false;
+            i = (i + 1) & mascara;
+        }
+        tabela[i].id = id;
+        tabela[i].posicao = posicao;
+        ocupados++;
+        return true;
+    }
+
+    // Reserva espaco para 'quantidade' ids sem realocar durante a carga
+    void limpar(size_t quantidade = 0) {
+        size_t tamanho = 16;
+        while (tamanho < quantidade * 2) tamanho *= 2;
+        tabela.assign(tamanho, Entrada{0, VAZIO});
+        ocupados = 0;
+    }
+
+private:
+    static const int VAZIO = -1;
+    struct Entrada {
+        int id;
+        int posicao; // VAZIO marca um balde livre
+    };
+    std::vector<Entrada> tabela; // Tamanho sempre potencia de 2
+    size_t ocupados;
+
+    // Mistura os bits do id (ids sequenciais nao caem em baldes vizinhos)
+    static size_t hashId(int id) {
+        unsigned int x = static_cast<unsigned int>(id);
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    void crescer() {
+        std::vector<Entrada> antiga;
+        antiga.swap(tabela);
+        tabela.assign(antiga.size() * 2, Entrada{0, VAZIO});
+        ocupados = 0;
+        for (const auto& e : antiga) {
+            if (e.posicao != VAZIO) inserir(e.id, e.posicao);
+        }
+    }
+};
+
+// === NORMALIZACAO DE NOMES PARA BUSCA ===
+// Minusculas sem acento para os caracteres Latin-1 0xC0..0xFF
+static const char DOBRA_LATIN1[65] =
+    "aaaaaaaceeeeiiiidnooooo*ouuuuyts"  // 0xC0..0xDF
+    "aaaaaaaceeeeiiiidnooooo/ouuuuyty"; // 0xE0..0xFF
+
+// Converte o nome para minusculas e remove acentos. Aceita tanto Latin-1
+// (console do Windows) quanto UTF-8 (sequencias 0xC3 0x80..0xBF).
+std::string normalizarNome(std::string_view nome) {
+    std::string normalizado;
+    normalizado.reserve(nome.size());
+    for (size_t i = 0; i < nome.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(nome[i]);
+        if (c == 0xC3 && i + 1 < nome.size() &&
+            (static_cast<unsigned char>(nome[i + 1]) & 0xC0) == 0x80) {
+            c = static_cast<unsigned char>(0xC0 + (static_cast<unsigned char>(nome[i + 1]) - 0x80));
+            i++;
+        }
+        if (c >= 0xC0) {
+            normalizado += DOBRA_LATIN1[c - 0xC0];
+        } else {
+            normalizado += static_cast<char>(std::tolower(c));
+        }
+    }
+    return normalizado;
+}
+
+// === INDICE DE TRIGRAMAS PARA BUSCA POR TRECHO DO NOME ===
+// Indice invertido: cada sequencia de 3 caracteres (trigrama) do nome
+// normalizado aponta para a lista de slots do catalogo que a contem. Um
+// trecho com 3 ou mais caracteres so pode estar nos produtos presentes em
+// todas as listas dos seus trigramas; apenas esses candidatos sao conferidos.
+class IndiceTrigramas {
+public:
+    struct Resultado {
+        int slot;
+        size_t posicao; // Onde o termo aparece no nome (0 = prefixo)
+    };
+
+    IndiceTrigramas() : construido(false) {}
+
+    bool estaConstruido() const { return construido; }
+    void invalidar() {
+        listas.clear();
+        nomes.clear();
+        construido = false;
+    }
+
+    // Reconstroi o indice inteiro a partir do catalogo
+    void construir(const ColunasProdutos& produtos) {
+        invalidar();
+        nomes.reserve(produtos.tamanho());
+        for (size_t i = 0; i < produtos.tamanho(); i++) {
+            adicionar(static_cast<int>(i), produtos.nome(i));
+        }
+        construido = true;
+    }
+
+    // Manutencao incremental (cadastro). Os slots chegam em ordem crescente,
+    // entao as listas continuam ordenadas apenas com push_back.
+    void adicionar(int slot, const char* nome) {
+        nomes.push_back(normalizarNome(nome));
+        const std::string& n = nomes.back();
+        for (size_t i = 0; i + 3 <= n.size(); i++) {
+            std::vector<int>& lista = listas[chaveTrigrama(n.data() + i)];
+            if (lista.empty() || lista.back() != slot) {
+                lista.push_back(slot);
+            }
+        }
+    }
+
+    // Busca o termo (ja normalizado). Devolve no maximo 'limite' resultados
+    // (0 = sem limite), priorizando nomes que comecam pelo termo e nomes
+    // mais curtos. 'total' recebe o numero total de produtos encontrados.
+    std::vector<Resultado> buscar(const std::string& termo, size_t limite, size_t& total) const {
+        std::vector<Resultado> resultados;
+        total = 0;
+
+        auto conferir = [&](int slot) {
+            size_t posicao = nomes[slot].find(termo);
+            if (posicao == std::string::npos) {
+                return;
+            }
+            total++;
+            resultados.push_back(Resultado{slot, posicao});
+            // Mantem so os 'limite' melhores num heap (o pior fica no topo)
+            if (limite > 0) {
+                std::push_heap(resultados.begin(), resultados.end(), melhorQue(this));
+                if (resultados.size() > limite) {
+                    std::pop_heap(resultados.begin(), resultados.end(), melhorQue(this));
+                    resultados.pop_back();
+                }
+            }
+        };
+
+        if (termo.size() < 3) {
+            // Termo curto demais para trigramas: confere todos os nomes
+            for (size_t i = 0; i < nomes.size(); i++) {
+                conferir(static_cast<int>(i));
+            }
+        } else {
+            // Junta as listas dos trigramas do termo, da menor para a maior
+            std::vector<const std::vector<int>*> postings;
+            for (size_t i = 0; i + 3 <= termo.size(); i++) {
+                auto it = listas.find(chaveTrigrama(termo.data() + i));
+                if (it == listas.end()) {
+                    return resultados; // Algum trigrama nao existe em nenhum nome
+                }
+                postings.push_back(&it->second);
+            }
+            std::sort(postings.begin(), postings.end(),
+                      [](const std::vector<int>* a, const std::vector<int>* b) { return a->size() < b->size(); });
+
+            std::vector<int> candidatos = *postings[0];
+            std::vector<int> intersecao;
+            for (size_t i = 1; i < postings.size() && !candidatos.empty(); i++) {
+                if (postings[i] == postings[i - 1]) {
+                    continue; // Trigrama repetido no termo
+                }
+                intersecao.clear();
+                std::set_intersection(candidatos.begin(), candidatos.end(),
+                                      postings[i]->begin(), postings[i]->end(),
+                                      std::back_inserter(intersecao));
+                candidatos.swap(intersecao);
+            }
+            for (int slot : candidatos) {
+                conferir(slot);
+            }
+        }
+
+        std::sort(resultados.begin(), resultados.end(), melhorQue(this));
+        return resultados;
+    }
+
+private:
+    std::unordered_map<unsigned int, std::vector<int>> listas;
+    std::vector<std::string> nomes; // Nome normalizado de cada slot
+    bool construido;
+
+    static unsigned int chaveTrigrama(const char* p) {
+        return (static_cast<unsigned int>(static_cast<unsigned char>(p[0])) << 16) |
+               (static_cast<unsigned int>(static_cast<unsigned char>(p[1])) << 8) |
+               static_cast<unsigned int>(static_cast<unsigned char>(p[2]));
+    }
+
+    // Ordem de relevancia: termo mais perto do inicio, depois nome mais curto
+    struct melhorQue {
+        const IndiceTrigramas* indice;
+        explicit melhorQue(const IndiceTrigramas* i) : indice(i) {}
+        bool operator()(const Resultado& a, const Resultado& b) const {
+            if (a.posicao != b.posicao) return a.posicao < b.posicao;
+            size_t ta = indice->nomes[a.slot].size(), tb = indice->nomes[b.slot].size();
+            if (ta != tb) return ta < tb;
+            return a.slot < b.slot;
+        }
+    };
+};
+
+// Tamanho e data de modificacao do arquivo de estoque, usados para saber se
+// o arquivo foi alterado em disco (por outro processo) desde a ultima leitura
+struct AssinaturaArquivo {
+    bool existe;
+    unsigned long long tamanho;
+    unsigned long long modificadoEm;
+
+    bool operator==(const AssinaturaArquivo& o) const {
+        return existe == o.existe && tamanho == o.tamanho && modificadoEm == o.modificadoEm;
+    }
+    bool operator!=(const AssinaturaArquivo& o) const { return !(*this == o); }
+};
+
+// Mutex isolado na sua propria linha de cache: threads travando fragmentos
+// vizinhos nao disputam a mesma linha (false sharing)
+struct alignas(64) FragmentoTrava {
+    std::mutex mtx;
+};
+
+// Resultado de uma movimentacao aplicada ao catalogo
+enum ResultadoMovimentacao {
+    MOV_OK,
+    MOV_PRODUTO_NAO_ENCONTRADO,
+    MOV_QUANTIDADE_INVALIDA,
+    MOV_SALDO_INSUFICIENTE,
+    MOV_SALDO_EXCEDIDO, // A ENTRADA passaria o saldo do limite de int32_t
+    MOV_ERRO_LOG,       // Linha nao entrou no log: nada mudou
+    MOV_NAO_CONFIRMADA  // Aplicada (memoria e log), mas o flush do log falhou
+};
+
+// Totais do estoque (usados tanto nos agregados incrementais quanto no
+// recalculo completo da verificacao)
+struct TotaisEstoque {
+    long long quantidade;
+    long long valorCentavos;   // Soma de quantidade x preco, em centavos
+    long long baixoEstoque;    // Produtos com quantidade < estoqueMinimo
+};
+
+// === KERNELS DE TOTALIZACAO (SIMD) ===
+// Varreduras das colunas de quantidade, preco e estoque minimo usadas no
+// recalculo dos totais e na selecao do relatorio. Ha uma versao escalar e uma
+// AVX2 (8 produtos por instrucao); a AVX2 so e usada se o processador tiver
+// suporte, detectado em tempo de execucao. As duas fazem as mesmas contas
+// inteiras (centavos em 64 bits), entao os resultados sao identicos.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define ALVO_AVX2 // O MSVC aceita intrinsicos AVX2 em qualquer funcao
+#else
+#define ALVO_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifndef PF_AVX2_INSTRUCTIONS_AVAILABLE
+#define PF_AVX2_INSTRUCTIONS_AVAILABLE 40 // SDKs antigos nao definem
+#endif
+
+struct KernelsEstoque {
+    const char* nome;
+    // Quantidade total, valor total e produtos abaixo do minimo em uma unica
+    // passada pelas tres colunas
+    TotaisEstoque (*totalizar)(const int32_t* quantidades, const int32_t* precos, const int32_t* minimos,
+                               size_t n);
+    // Acrescenta a 'saida' os slots em [inicio, fim) com quantidade < minimo,
+    // em ordem crescente (vetor de selecao)
+    void (*selecionarBaixoEstoque)(const int32_t* quantidades, const int32_t* minimos, size_t inicio,
+                                   size_t fim, std::vector<int>& saida);
+};
+
+static TotaisEstoque totalizarEscalar(const int32_t* quantidades, const int32_t* precos, const int32_t* minimos,
+                                      size_t n) {
+    TotaisEstoque totais = {0, 0, 0};
+    for (size_t i = 0; i < n; i++) {
+        totais.quantidade += quantidades[i];
+        totais.valorCentavos += static_cast<long long>(quantidades[i]) * precos[i];
+        totais.baixoEstoque += quantidades[i] < minimos[i];
+    }
+    return totais;
+}
+
+static void selecionarBaixoEstoqueEscalar(const int32_t* quantidades, const int32_t* minimos, size_t inicio,
+                                          size_t fim, std::vector<int>& saida) {
+    for (size_t i = inicio; i < fim; i++) {
+        if (quantidades[i] < minimos[i]) {
+            saida.push_back(static_cast<int>(i));
+        }
+    }
+}
+
+ALVO_AVX2 static long long somarLanes64(__m256i v) {
+    alignas(32) long long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+ALVO_AVX2 static TotaisEstoque totalizarAvx2(const int32_t* quantidades, const int32_t* precos,
+                                             const int32_t* minimos, size_t n) {
+    __m256i somaQuantidade = _mm256_setzero_si256(); // 4 acumuladores de 64 bits
+    __m256i somaValor = _mm256_setzero_si256();
+    __m256i contagemBaixo = _mm256_setzero_si256(); // 8 contadores de 32 bits
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(quantidades + i));
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(precos + i));
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(minimos + i));
+
+        // Quantidades estendidas para 64 bits antes de somar
+        somaQuantidade = _mm256_add_epi64(somaQuantidade, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(q)));
+        somaQuantidade = _mm256_add_epi64(somaQuantidade, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(q, 1)));
+
+        // mul_epi32 multiplica as lanes pares (32 x 32 -> 64 bits com sinal);
+        // as impares sao trazidas para a posicao par com um deslocamento
+        __m256i pares = _mm256_mul_epi32(q, p);
+        __m256i impares = _mm256_mul_epi32(_mm256_srli_epi64(q, 32), _mm256_srli_epi64(p, 32));
+        somaValor = _mm256_add_epi64(somaValor, _mm256_add_epi64(pares, impares));
+
+        // A comparacao da -1 nas lanes abaixo do minimo
+        contagemBaixo = _mm256_sub_epi32(contagemBaixo, _mm256_cmpgt_epi32(m, q));
+    }
+
+    alignas(32) int32_t contagens[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(contagens), contagemBaixo);
+    TotaisEstoque totais = totalizarEscalar(quantidades + i, precos + i, minimos + i, n - i);
+    totais.quantidade += somarLanes64(somaQuantidade);
+    totais.valorCentavos += somarLanes64(somaValor);
+    for (int lane = 0; lane < 8; lane++) {
+        totais.baixoEstoque += static_cast<uint32_t>(contagens[lane]);
+    }
+    return totais;
+}
+
+ALVO_AVX2 static void selecionarBaixoEstoqueAvx2(const int32_t* quantidades, const int32_t* minimos, size_t inicio,
+                                                 size_t fim, std::vector<int>& saida) {
+    size_t i = inicio;
+    for (; i + 8 <= fim; i += 8) {
+        __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(quantidades + i));
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(minimos + i));
+        // Um bit por lane abaixo do minimo; na maioria dos blocos nao ha nenhum
+        int mascara = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(m, q)));
+        while (mascara != 0) {
+            int lane = 0;
+            while (((mascara >> lane) & 1) == 0) {
+                lane++;
+            }
+            saida.push_back(static_cast<int>(i + lane));
+            mascara &= mascara - 1; // Apaga o bit menos significativo
+        }
+    }
+    selecionarBaixoEstoqueEscalar(quantidades, minimos, i, fim, saida);
+}
+
+static const KernelsEstoque KERNELS_ESCALAR = {"escalar", totalizarEscalar, selecionarBaixoEstoqueEscalar};
+static const KernelsEstoque KERNELS_AVX2 = {"avx2", totalizarAvx2, selecionarBaixoEstoqueAvx2};
+
+static bool processadorTemAvx2() {
+    // SYSTEM CALL: IsProcessorFeaturePresent - O sistema informa se a CPU (e o
+    // proprio sistema, que salva os registradores YMM) suportam AVX2
+    return IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE) != FALSE;
+}
+
+// Kernels em uso: escolhidos na primeira chamada, ou forcados com --kernel
+static const KernelsEstoque* kernelsAtivos = NULL;
+
+const KernelsEstoque& kernelsEstoque() {
+    if (kernelsAtivos == NULL) {
+        kernelsAtivos = processadorTemAvx2() ? &KERNELS_AVX2 : &KERNELS_ESCALAR;
+    }
+    return *kernelsAtivos;
+}
+
+// Numero de pedacos para dividir n produtos entre threads: o pedido
+// explicitamente, ou (0 = automatico) um por nucleo sem pedacos pequenos
+// demais para compensar criar a thread
+static size_t pedacosParaThreads(size_t n, unsigned numThreads) {
+    const size_t MINIMO_POR_THREAD = 16384;
+    size_t pedacos = numThreads;
+    if (numThreads == 0) {
+        pedacos = std::max(1u, std::thread::hardware_concurrency());
+        pedacos = std::min(pedacos, n / MINIMO_POR_THREAD);
+    }
+    return std::max<size_t>(1, std::min(pedacos, n));
+}
+
+// Executa funcao(pedaco, inicio, fim) sobre [0, n) dividido em pedacos
+// consecutivos, um por thread; o pedaco 0 roda na thread chamadora
+template <typename Funcao>
+static void executarEmPedacos(size_t n, size_t pedacos, Funcao funcao) {
+    std::vector<std::thread> threads;
+    size_t porThread = (n + pedacos - 1) / pedacos;
+    for (size_t t = 1; t < pedacos; t++) {
+        size_t inicio = std::min(n, t * porThread);
+        threads.emplace_back(funcao, t, inicio, std::min(n, inicio + porThread));
+    }
+    funcao(size_t(0), size_t(0), std::min(n, porThread));
+    for (auto& th : threads) {
+        th.join();
+    }
+}
+
+TotaisEstoque totalizarColunas(const ColunasProdutos& produtos, const KernelsEstoque& kernels,
+                               unsigned numThreads = 0) {
+    size_t pedacos = pedacosParaThreads(produtos.tamanho(), numThreads);
+    std::vector<TotaisEstoque> parciais(pedacos);
+    executarEmPedacos(produtos.tamanho(), pedacos, [&](size_t t, size_t inicio, size_t fim) {
+        parciais[t] = kernels.totalizar(produtos.quantidades.data() + inicio, produtos.precosCentavos.data() + inicio,
+                                        produtos.estoquesMinimos.data() + inicio, fim - inicio);
+    });
+
+    TotaisEstoque totais = {0, 0, 0};
+    for (const auto& parcial : parciais) {
+        totais.quantidade += parcial.quantidade;
+        totais.valorCentavos += parcial.valorCentavos;
+        totais.baixoEstoque += parcial.baixoEstoque;
+    }
+    return totais;
+}
+
+// Vetor de selecao com os slots abaixo do estoque minimo, em ordem de slot
+std::vector<int> selecionarBaixoEstoque(const ColunasProdutos& produtos, const KernelsEstoque& kernels,
+                                        unsigned numThreads = 0) {
+    size_t pedacos = pedacosParaThreads(produtos.tamanho(), numThreads);
+    std::vector<std::vector<int>> parciais(pedacos);
+    executarEmPedacos(produtos.tamanho(), pedacos, [&](size_t t, size_t inicio, size_t fim) {
+        kernels.selecionarBaixoEstoque(produtos.quantidades.data(), produtos.estoquesMinimos.data(), inicio, fim,
+                                       parciais[t]);
+    });
+
+    // Os pedacos sao consecutivos, entao a concatenacao continua em ordem
+    std::vector<int> selecao = std::move(parciais[0]);
+    for (size_t t = 1; t < pedacos; t++) {
+        selecao.insert(selecao.end(), parciais[t].begin(), parciais[t].end());
+    }
+    return selecao;
+}
+
+// === ESCRITOR DO LOG DE MOVIMENTACOES ===
+// Quando uma movimentacao so e confirmada depois de chegar ao disco
+enum ModoDurabilidade {
+    DURABILIDADE_NENHUMA,          // So WriteFile: o sistema grava quando quiser
+    DURABILIDADE_POR_MOVIMENTACAO, // FlushFileBuffers a cada movimentacao
+    DURABILIDADE_GRUPO             // Um FlushFileBuffers por grupo (group commit)
+};
+
+// Nome do modo como aparece na linha de comando
+static const char* nomeDoModo(ModoDurabilidade modo) {
+    static const char* NOMES_MODO[] = {"nenhuma", "movimento", "grupo"};
+    return NOMES_MODO[modo];
+}
+
+// Mantem o log aberto (FILE_APPEND_DATA) entre as movimentacoes, em vez de
+// abrir/escrever/fechar a cada uma. No modo em grupo, a primeira movimentacao
+// que precisa de flush vira a "lider": espera a janela (ex.: 2 ms) para que
+// outras movimentacoes concorrentes escrevam suas linhas e faz um unico
+// FlushFileBuffers por todas. As demais so esperam a lider terminar.
+class EscritorLog {
+public:
+    static const int FAIXAS_LATENCIA = 32; // Faixa i: latencia < 2^i microssegundos
+
+    void configurar(ModoDurabilidade novoModo, int janelaMicrossegundos);
+    ModoDurabilidade modoAtual() const { return modo; }
+
+    // Acrescenta uma linha ao log e devolve o numero dela (ticket). Deve ser
+    // chamado com catalogo.mutexArquivos travado (ordem das linhas).
+    bool acrescentar(const char* linha, size_t tamanho, uint64_t& ticket);
+    // Espera a linha do ticket chegar ao disco conforme o modo. Chamado fora
+    // de mutexArquivos, para que outras linhas entrem no mesmo grupo.
+    bool confirmar(uint64_t ticket, LARGE_INTEGER inicio);
+    // Fecha o arquivo (checkpoint, recarga e lote mexem no log por conta
+    // propria); a proxima linha reabre. Chamado com mutexArquivos travado.
+    void fechar();
+
+    void exibirEstatisticas();
+    std::string resumoEstatisticas();
+
+private:
+    bool abrir();
+    void registrarLatencia(LARGE_INTEGER inicio);
+    double percentilLatencia(double fracao);
+
+    ModoDurabilidade modo = DURABILIDADE_GRUPO;
+    int janelaMicros = 2000;
+
+    // Estado do commit em grupo (protegido por mutexCommit). hLog tambem: a
+    // lider copia o handle antes de soltar a trava, e fechar() espera a lider
+    // terminar antes de fecha-lo
+    std::mutex mutexCommit;
+    HANDLE hLog = INVALID_HANDLE_VALUE;
+    std::condition_variable commitConcluido;
+    std::atomic<uint64_t> escritos{0};   // Ultimo ticket escrito no log
+    uint64_t duraveis = 0;               // Ultimo ticket ja no disco
+    uint64_t falhouAte = 0;              // Tickets <= falhouAte perderam o flush
+    bool liderAtiva = false;
+
+    // Estatisticas
+    std::atomic<uint64_t> latencias[FAIXAS_LATENCIA] = {};
+    std::atomic<uint64_t> totalCommits{0};
+    std::atomic<uint64_t> somaLatenciaMicros{0};
+    std::atomic<uint64_t> maiorLatenciaMicros{0};
+    uint64_t totalFlushes = 0;           // Protegidos por mutexCommit
+    uint64_t somaTamanhoGrupo = 0;
+    uint64_t maiorGrupo = 0;
+};
+
+// Linha ja escrita no log que ainda precisa ser confirmada (flush)
+struct CommitPendente {
+    uint64_t ticket;
+    LARGE_INTEGER inicio;
+};
+
+// === CATALOGO RESIDENTE EM MEMORIA ===
+// O arquivo de estoque e lido uma unica vez e mantido em memoria; as operacoes
+// do menu trabalham sobre este catalogo e so voltam a ler o arquivo quando a
+// assinatura dele em disco muda.
+struct CatalogoEstoque {
+    ColunasProdutos produtos;
+    IndiceHashId indice;
+    IndiceTrigramas trigramas; // Construido na primeira busca, depois incremental
+    AssinaturaArquivo assinatura = {false, 0, 0};
+    // Escrevemos registros no lugar em estoque.dat desde a ultima leitura da
+    // assinatura. Essas escritas nao mudam o tamanho do arquivo; a assinatura
+    // e relida uma vez (checkpoint ou proxima verificacao), nao a cada uma.
+    std::atomic<bool> assinaturaDesatualizada{false};
+    bool carregado = false;
+
+    // Estado do log de movimentacoes. O log e a fonte da verdade: o arquivo de
+    // estoque e apenas o ultimo checkpoint, e o log e reaplicado sobre ele.
+    AssinaturaArquivo assinaturaLog = {false, 0, 0};
+    std::atomic<bool> assinaturaLogDesatualizada{false}; // Escrevemos no log desde a ultima leitura dela
+    // Bytes que nos mesmos acrescentamos ao log desde que assinaturaLog foi
+    // lida: o tamanho esperado do log e assinaturaLog.tamanho + este valor.
+    // Protegido por mutexArquivos (zerado sempre que assinaturaLog e relida).
+    unsigned long long bytesLogProprios = 0;
+    EscritorLog escritorLog;
+    // Movimentacoes do log ainda nao passadas para o historico binario (vao
+    // no checkpoint, antes de o log ser esvaziado). Protegido por mutexArquivos.
+    std::vector<RegistroHistorico> historicoPendente;
+    unsigned long long proximaSequencia = 1;
+    int movimentacoesPendentes = 0; // Registros no log desde o ultimo checkpoint
+
+    // Quando estoque.dat existe ele e o checkpoint (no lugar de estoque.txt) e
+    // fica aberto para as escritas posicionadas de cada movimentacao
+    bool usaBinario = false;
+    HANDLE hBinario = INVALID_HANDLE_VALUE;
+    // estoque.dat esta atras das colunas: movimentacoes reaplicadas do log
+    // (so existem em memoria) ou uma escrita posicionada que falhou. O
+    // checkpoint regrava todos os registros antes de esvaziar o log.
+    std::atomic<bool> registrosBinariosAtrasados{false};
+
+    // === CONCORRENCIA (modo servidor) ===
+    // mutexCatalogo: compartilhado para consultas e movimentacoes (a estrutura
+    // do vetor/indices nao muda); exclusivo para cadastro, recarga e checkpoint.
+    // fragmentos: a movimentacao trava apenas o fragmento do produto, entao o
+    // teste de saldo e a baixa da SAIDA sao atomicos sem serializar produtos
+    // diferentes. mutexArquivos: sequencia do log, contadores e assinaturas.
+    std::shared_mutex mutexCatalogo;
+    FragmentoTrava fragmentos[NUM_FRAGMENTOS];
+    std::mutex mutexArquivos;
+
+    // === AGREGADOS INCREMENTAIS ===
+    // Atualizados a cada movimentacao/cadastro (atomicos: movimentacoes de
+    // fragmentos diferentes acontecem ao mesmo tempo). O resumo do relatorio
+    // le estes valores em O(1), sem percorrer os produtos.
+    std::atomic<long long> totalQuantidade{0};
+    std::atomic<long long> valorTotalCentavos{0};
+    std::atomic<long long> produtosBaixoEstoque{0};
+};
+
+CatalogoEstoque catalogo;
 
 // Prototipos das funcoes
 void cadastrarProduto();
@@ -58,9 +932,45 @@ void darEntradaEmProduto();
 void gerarRelatorio();
 void exibirMenu();
 void tratarErro(const char* operacao);
-std::vector<Produto> lerProdutosDoArquivo();
-void salvarProdutosNoArquivo(const std::vector<Produto>& produtos);
-void registrarMovimentacao(const Produto& produto, int quantidade, const std::string& tipo);
+bool lerProdutosDoArquivo(ColunasProdutos& produtos);
+bool salvarProdutosNoArquivo(const ColunasProdutos& produtos);
+bool registrarMovimentacao(int id, int quantidade, int saldo, const std::string& tipo, CommitPendente& pendente);
+bool confirmarMovimentacao(const CommitPendente& pendente);
+ResultadoMovimentacao aplicarMovimentacao(int id, int quantidade, bool entrada, Produto* resultado);
+ResultadoMovimentacao definirEstoqueMinimo(int id, int minimo, Produto* resultado);
+void contabilizarProduto(size_t slot, int sinal);
+TotaisEstoque calcularTotais(const ColunasProdutos& produtos);
+void recalcularAgregados();
+int verificarAgregados();
+void configurarEstoqueMinimo();
+bool gravarNovoProduto(const Produto& produto);
+void realizarCheckpointSeNecessario();
+int executarServidor();
+int executarCliente();
+void reaplicarLogDeMovimentacoes();
+bool realizarCheckpoint();
+bool lerProdutosDoArquivoBinario(ColunasProdutos& produtos);
+bool salvarProdutosNoArquivoBinario(const ColunasProdutos& produtos);
+bool gravarRegistroBinario(int slot, const Produto& produto);
+bool gravarCabecalhoBinario(uint64_t quantidadeRegistros);
+bool regravarRegistrosBinarios();
+void converterEstoque();
+bool abrirArquivoBinario();
+void fecharArquivoBinario();
+int processarLoteDeMovimentacoes(const char* arquivoMovimentos, const char* arquivoRejeitados,
+                                 bool exibirResumo = true);
+int executarBenchmark(int argc, char* argv[], bool durabilidadeEscolhida);
+AssinaturaArquivo obterAssinaturaArquivo(const char* nomeArquivo);
+void garantirCatalogoAtualizado();
+int buscarSlotPorId(int id);
+bool inserirProdutoNoCatalogo(const Produto& produto);
+void formatarDataHora(const SYSTEMTIME& momento, char* destino, size_t tamanho);
+uint32_t momentoHistorico(const SYSTEMTIME& data);
+RegistroHistorico registroHistorico(uint32_t momento, int idProduto, int quantidade, const char* tipo);
+bool gravarHistorico(std::vector<RegistroHistorico>& registros);
+int consultarHistorico(uint32_t de, uint32_t ate, int idProduto, int tipo);
+int converterHistoricoLegado(const char* arquivoLegado);
+int executarConsultaHistorico(int argc, char* argv[]);
 
 // Funcao auxiliar para tratar erros da API do Windows
 void tratarErro(const char* operacao) {
@@ -68,6 +978,186 @@ void tratarErro(const char* operacao) {
     std::cerr << "ERRO ao " << operacao << ". Codigo: " << erro << std::endl;
 }
 
+// Formata a linha "id|nome|quantidade|preco[|minimo]" do arquivo texto. O
+// estoque minimo so e gravado quando difere do padrao, entao arquivos sem
+// limites personalizados continuam no formato original de 4 campos.
+int formatarLinhaProduto(char* linha, size_t tamanho, int id, const char* nome, int quantidade, double preco,
+                         int estoqueMinimo) {
+    if (estoqueMinimo == ESTOQUE_MINIMO_PADRAO) {
+        return sprintf_s(linha, tamanho, "%d|%s|%d|%.2f\n", id, nome, quantidade, preco);
+    }
+    return sprintf_s(linha, tamanho, "%d|%s|%d|%.2f|%d\n", id, nome, quantidade, preco, estoqueMinimo);
+}
+
+// SYSTEM CALL: GetFileAttributesEx - Le tamanho e data de modificacao do arquivo
+// sem precisar abri-lo
+AssinaturaArquivo obterAssinaturaArquivo(const char* nomeArquivo) {
+    AssinaturaArquivo assinatura = {false, 0, 0};
+    WIN32_FILE_ATTRIBUTE_DATA dados;
+    if (GetFileAttributesExA(nomeArquivo, GetFileExInfoStandard, &dados)) {
+        assinatura.existe = true;
+        assinatura.tamanho = (static_cast<unsigned long long>(dados.nFileSizeHigh) << 32) | dados.nFileSizeLow;
+        assinatura.modificadoEm = (static_cast<unsigned long long>(dados.ftLastWriteTime.dwHighDateTime) << 32) |
+                                  dados.ftLastWriteTime.dwLowDateTime;
+    }
+    return assinatura;
+}
+
+// Carrega o catalogo na primeira chamada e recarrega apenas se o arquivo de
+// estoque tiver sido alterado em disco desde a ultima leitura/escrita nossa
+void garantirCatalogoAtualizado() {
+    // As nossas proprias escritas no log nao forcam recarga: a assinatura e
+    // atualizada aqui, uma vez, em vez de a cada movimentacao. So e aceita se
+    // o log tiver exatamente o tamanho esperado pelas nossas escritas; se
+    // outro processo tambem mexeu nele, a assinatura antiga continua
+    // diferente da atual e o catalogo e recarregado logo abaixo.
+    if (catalogo.assinaturaLogDesatualizada) {
+        std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+        if (catalogo.assinaturaLogDesatualizada.exchange(false)) {
+            AssinaturaArquivo atualLog = obterAssinaturaArquivo(ARQUIVO_LOG_MOVIMENTACOES);
+            if (atualLog.existe &&
+                atualLog.tamanho == catalogo.assinaturaLog.tamanho + catalogo.bytesLogProprios) {
+                catalogo.assinaturaLog = atualLog;
+                catalogo.bytesLogProprios = 0;
+            }
+        }
+    }
+    // Mesma ideia para os registros que reescrevemos em estoque.dat: aceita a
+    // assinatura nova se o tamanho nao mudou
+    if (catalogo.assinaturaDesatualizada) {
+        std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+        if (catalogo.assinaturaDesatualizada.exchange(false) && catalogo.usaBinario) {
+            AssinaturaArquivo atualBinario = obterAssinaturaArquivo(ARQUIVO_ESTOQUE_BINARIO);
+            if (atualBinario.existe && atualBinario.tamanho == catalogo.assinatura.tamanho) {
+                catalogo.assinatura = atualBinario;
+            }
+        }
+    }
+
+    // Se existe o arquivo binario, ele e o checkpoint; senao, o arquivo texto
+    AssinaturaArquivo atualBinario = obterAssinaturaArquivo(ARQUIVO_ESTOQUE_BINARIO);
+    bool usaBinario = atualBinario.existe;
+    AssinaturaArquivo atual = usaBinario ? atualBinario : obterAssinaturaArquivo(ARQUIVO_ESTOQUE);
+    AssinaturaArquivo atualLog = obterAssinaturaArquivo(ARQUIVO_LOG_MOVIMENTACOES);
+    if (catalogo.carregado && usaBinario == catalogo.usaBinario &&
+        atual == catalogo.assinatura && atualLog == catalogo.assinaturaLog) {
+        return;
+    }
+
+    fecharArquivoBinario();
+    {
+        // A reaplicacao pode cortar o fim do log: o escritor reabre depois
+        std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+        catalogo.escritorLog.fechar();
+    }
+
+    ColunasProdutos lidos;
+    if (usaBinario) {
+        if (!lerProdutosDoArquivoBinario(lidos)) {
+            lidos = ColunasProdutos();
+        }
+    } else {
+        lerProdutosDoArquivo(lidos);
+    }
+    catalogo.usaBinario = usaBinario;
+
+    // Assume as colunas lidas (sem copiar os produtos) e monta o indice,
+    // compactando no lugar as linhas com ID repetido
+    catalogo.produtos.trocar(lidos);
+    catalogo.indice.limpar(catalogo.produtos.tamanho());
+
+    int duplicados = 0;
+    size_t destino = 0;
+    for (size_t i = 0; i < catalogo.produtos.tamanho(); i++) {
+        if (catalogo.indice.inserir(catalogo.produtos.ids[i], static_cast<int>(destino))) {
+            if (destino != i) {
+                catalogo.produtos.mover(destino, i);
+            }
+            destino++;
+        } else {
+            duplicados++;
+        }
+    }
+    catalogo.produtos.truncar(destino);
+    catalogo.trigramas.invalidar(); // Reconstruido sob demanda na proxima busca
+    if (duplicados > 0) {
+        std::cerr << "AVISO: " << duplicados << " linha(s) com ID repetido ignorada(s) em '"
+                  << (usaBinario ? ARQUIVO_ESTOQUE_BINARIO : ARQUIVO_ESTOQUE) << "'." << std::endl;
+    }
+
+    // Mantem o arquivo binario aberto para as escritas posicionadas. Com
+    // linhas removidas os slots nao batem mais com as posicoes no arquivo:
+    // ele e regravado compactado antes (e antes da reaplicacao do log, que
+    // so marca os registros como atrasados). Se a regravacao falhar o
+    // arquivo fica fechado, as escritas no lugar falham e o checkpoint nao
+    // esvazia o log.
+    if (usaBinario) {
+        if (duplicados == 0 || salvarProdutosNoArquivoBinario(catalogo.produtos)) {
+            abrirArquivoBinario();
+        }
+    }
+
+    // O arquivo de estoque e o ultimo checkpoint; as movimentacoes posteriores
+    // estao no log e sao reaplicadas por cima dele
+    reaplicarLogDeMovimentacoes();
+    recalcularAgregados();
+
+    catalogo.assinatura = obterAssinaturaArquivo(usaBinario ? ARQUIVO_ESTOQUE_BINARIO : ARQUIVO_ESTOQUE);
+    {
+        std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+        catalogo.assinaturaLog = obterAssinaturaArquivo(ARQUIVO_LOG_MOVIMENTACOES);
+        catalogo.bytesLogProprios = 0;
+    }
+    catalogo.carregado = true;
+}
+
+// Busca O(1) da posicao (slot) de um produto nas colunas pelo indice hash;
+// -1 se o ID nao existir
+int buscarSlotPorId(int id) {
+    return catalogo.indice.buscar(id);
+}
+
+// Insere um produto no catalogo; falha (sem varrer o vetor) se o ID ja existir
+bool inserirProdutoNoCatalogo(const Produto& produto) {
+    int slot = static_cast<int>(catalogo.produtos.tamanho());
+    if (!catalogo.indice.inserir(produto.id, slot)) {
+        return false;
+    }
+    catalogo.produtos.adicionar(produto);
+    contabilizarProduto(slot, +1);
+    if (catalogo.trigramas.estaConstruido()) {
+        catalogo.trigramas.adicionar(slot, produto.nome);
+    }
+    return true;
+}
+
+// Soma (sinal = +1) ou retira (sinal = -1) a contribuicao de um produto nos
+// agregados. Uma alteracao e feita retirando o estado antigo e somando o novo.
+void contabilizarProduto(size_t slot, int sinal) {
+    const ColunasProdutos& produtos = catalogo.produtos;
+    long long quantidade = produtos.quantidades[slot];
+    catalogo.totalQuantidade.fetch_add(sinal * quantidade, std::memory_order_relaxed);
+    catalogo.valorTotalCentavos.fetch_add(sinal * quantidade * produtos.precosCentavos[slot],
+                                          std::memory_order_relaxed);
+    if (quantidade < produtos.estoquesMinimos[slot]) {
+        catalogo.produtosBaixoEstoque.fetch_add(sinal, std::memory_order_relaxed);
+    }
+}
+
+// Recalculo completo (O(n)), usado na carga e na verificacao. Percorre so
+// as colunas de quantidade, preco e estoque minimo (nomes e IDs nao entram),
+// com os kernels em uso e dividido entre os nucleos.
+TotaisEstoque calcularTotais(const ColunasProdutos& produtos) {
+    return totalizarColunas(produtos, kernelsEstoque());
+}
+
+void recalcularAgregados() {
+    TotaisEstoque totais = calcularTotais(catalogo.produtos);
+    catalogo.totalQuantidade = totais.quantidade;
+    catalogo.valorTotalCentavos = totais.valorCentavos;
+    catalogo.produtosBaixoEstoque = totais.baixoEstoque;
+}
+
 // 1. SYSTEM CALLS: CreateFile + WriteFile - Cadastro de produto
 void cadastrarProduto() {
     std::cout << "\n=== CADASTRO DE PRODUTO ===\n";
@@ -79,6 +1169,14 @@ void cadastrarProduto() {
     std::cout << "ID do produto: ";
     std::cin >> novoProduto.id;
     std::cin.ignore(); // Limpa o buffer de entrada
+
+    // Rejeita IDs duplicados consultando o indice hash (sem varrer o estoque)
+    garantirCatalogoAtualizado();
+    if (buscarSlotPorId(novoProduto.id) >= 0) {
+        std::cout << "? Erro: Ja existe um produto com o ID " << novoProduto.id << "!" << std::endl;
+        return;
+    }
+
     std::cout << "Nome do produto: ";
     std::getline(std::cin, nomeTemp);
     strcpy_s(novoProduto.nome, nomeTemp.c_str());
@@ -87,6 +1185,40 @@ void cadastrarProduto() {
     std::cout << "Preco (R$): ";
     std::cin >> novoProduto.preco;
     std::cin.ignore();
+    std::cout << "Estoque minimo (ENTER = " << ESTOQUE_MINIMO_PADRAO << "): ";
+    std::string textoMinimo;
+    std::getline(std::cin, textoMinimo);
+    novoProduto.estoqueMinimo = textoMinimo.empty() ? ESTOQUE_MINIMO_PADRAO : atoi(textoMinimo.c_str());
+
+    if (!precoCabeNaColuna(novoProduto.preco)) {
+        std::cout << "? Erro: Preco fora da faixa suportada (ate R$ 21474836.47)." << std::endl;
+        return;
+    }
+    if (gravarNovoProduto(novoProduto)) {
+        std::cout << "? Produto cadastrado com sucesso!" << std::endl;
+    }
+}
+
+// Grava o novo produto no arquivo de estoque e o insere no catalogo. Trava o
+// catalogo com exclusividade: o vetor pode ser realocado na insercao.
+bool gravarNovoProduto(const Produto& novoProduto) {
+    if (!precoCabeNaColuna(novoProduto.preco)) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> trava(catalogo.mutexCatalogo);
+    if (buscarSlotPorId(novoProduto.id) >= 0) {
+        return false; // Outra sessao cadastrou o mesmo ID
+    }
+
+    // No formato binario o produto vira um novo registro no fim do arquivo
+    if (catalogo.usaBinario) {
+        int slot = static_cast<int>(catalogo.produtos.tamanho());
+        if (!gravarRegistroBinario(slot, novoProduto) || !gravarCabecalhoBinario(slot + 1)) {
+            return false;
+        }
+        inserirProdutoNoCatalogo(novoProduto);
+        return true;
+    }
 
     // SYSTEM CALL: CreateFile - Abre o arquivo para escrita no modo de anexar (append)
     HANDLE hArquivo = CreateFileA(
@@ -101,7 +1233,7 @@ void cadastrarProduto() {
 
     if (hArquivo == INVALID_HANDLE_VALUE) {
         tratarErro("criar/abrir arquivo de estoque");
-        return;
+        return false;
     }
 
     // SYSTEM CALL: SetFilePointer - Move o ponteiro para o final do arquivo
@@ -109,8 +1241,8 @@ void cadastrarProduto() {
 
     // Formata a linha de dados a ser escrita no arquivo
     char linha[MAX_NOME + 50]; // Tamanho suficiente para os dados
-    sprintf_s(linha, sizeof(linha), "%d|%s|%d|%.2f\n",
-              novoProduto.id, novoProduto.nome, novoProduto.quantidade, novoProduto.preco);
+    formatarLinhaProduto(linha, sizeof(linha), novoProduto.id, novoProduto.nome, novoProduto.quantidade,
+                         novoProduto.preco, novoProduto.estoqueMinimo);
 
     DWORD bytesEscritos;
     // SYSTEM CALL: WriteFile - Escreve a linha no arquivo
@@ -121,364 +1253,2820 @@ void cadastrarProduto() {
                    NULL)) {
         tratarErro("escrever no arquivo");
         CloseHandle(hArquivo);
-        return;
+        return false;
     }
 
     // SYSTEM CALL: CloseHandle - Fecha o arquivo para liberar o recurso
     CloseHandle(hArquivo);
-    std::cout << "? Produto cadastrado com sucesso! (" << bytesEscritos << " bytes escritos)" << std::endl;
+
+    // Mantem o catalogo em memoria sincronizado com o que foi gravado
+    inserirProdutoNoCatalogo(novoProduto);
+    std::lock_guard<std::mutex> travaArquivos(catalogo.mutexArquivos);
+    catalogo.assinatura = obterAssinaturaArquivo(ARQUIVO_ESTOQUE);
+    return true;
 }
 
-// 2. SYSTEM CALLS: CreateFile + ReadFile - Listagem de produtos
-void listarProdutos() {
-    std::cout << "\n=== PRODUTOS EM ESTOQUE ===\n";
+// 2. Listagem de produtos (a partir do catalogo residente em memoria)
+void listarProdutos() {
+    std::cout << "\n=== PRODUTOS EM ESTOQUE ===\n";
+
+    // O arquivo so e lido novamente se tiver mudado desde a ultima carga
+    garantirCatalogoAtualizado();
+    if (catalogo.produtos.vazio()) {
+        std::cout << "Estoque vazio." << std::endl;
+        return;
+    }
+
+    // Exibe o cabecalho
+    printf("ID\t| Nome\t\t\t\t| Quantidade\t| Preco (R$)\n");
+    printf("--------------------------------------------------------------------------------\n");
+
+    const ColunasProdutos& produtos = catalogo.produtos;
+    for (size_t i = 0; i < produtos.tamanho(); i++) {
+        printf("%d\t| %-25s\t| %-10d\t| %.2f\n",
+               produtos.ids[i], produtos.nome(i), produtos.quantidades[i], produtos.preco(i));
+    }
+
+    std::cout << "\nTotal de produtos: " << catalogo.produtos.tamanho() << std::endl;
+}
+
+// 3. Busca de produto por trecho do nome (indice de trigramas)
+void buscarProduto() {
+    std::cout << "\n=== BUSCAR PRODUTO ===\n";
+    std::cout << "Digite o nome (ou parte dele): ";
+    std::string termoBusca;
+    std::getline(std::cin, termoBusca);
+    std::cout << "Maximo de resultados (0 = todos, ENTER = 20): ";
+    std::string textoLimite;
+    std::getline(std::cin, textoLimite);
+    size_t limite = textoLimite.empty() ? 20 : static_cast<size_t>(std::max(0, atoi(textoLimite.c_str())));
+
+    // Filtra o catalogo residente (o arquivo so e relido se tiver mudado)
+    garantirCatalogoAtualizado();
+    const ColunasProdutos& produtos = catalogo.produtos;
+
+    if (produtos.vazio()) {
+        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
+        return;
+    }
+
+    // O indice e montado uma vez; depois o cadastro o mantem atualizado
+    if (!catalogo.trigramas.estaConstruido()) {
+        catalogo.trigramas.construir(produtos);
+    }
+
+    // O termo e normalizado uma unica vez (os nomes ja estao no indice)
+    size_t encontrados = 0;
+    std::vector<IndiceTrigramas::Resultado> resultados =
+        catalogo.trigramas.buscar(normalizarNome(termoBusca), limite, encontrados);
+
+    std::cout << "\nResultados da busca:\n";
+    std::cout << "----------------------------------------------------------------\n";
+
+    for (const auto& r : resultados) {
+        printf("ID: %d | Nome: %s | Quantidade: %d | Preco: %.2f\n",
+               produtos.ids[r.slot], produtos.nome(r.slot), produtos.quantidades[r.slot], produtos.preco(r.slot));
+    }
+
+    if (encontrados == 0) {
+        std::cout << "Nenhum produto encontrado com esse nome." << std::endl;
+    } else if (resultados.size() < encontrados) {
+        std::cout << "\n" << encontrados << " produto(s) encontrado(s); exibindo os "
+                  << resultados.size() << " mais relevantes." << std::endl;
+    } else {
+        std::cout << "\n" << encontrados << " produto(s) encontrado(s)." << std::endl;
+    }
+}
+
+// Aplica uma ENTRADA ou SAIDA ao catalogo, registra no log e (no formato
+// binario) atualiza o registro no lugar. Seguro para varias threads: trava o
+// catalogo em modo compartilhado e apenas o fragmento do produto, de modo que
+// o teste de saldo e a baixa acontecem juntos e o log sai na mesma ordem
+// das alteracoes do produto. 'resultado' recebe uma copia do produto.
+ResultadoMovimentacao aplicarMovimentacao(int id, int quantidade, bool entrada, Produto* resultado) {
+    if (quantidade <= 0) {
+        return MOV_QUANTIDADE_INVALIDA;
+    }
+
+    CommitPendente pendente;
+    {
+        std::shared_lock<std::shared_mutex> travaCatalogo(catalogo.mutexCatalogo);
+        int slot = catalogo.indice.buscar(id); // Busca O(1) pelo indice hash
+        if (slot < 0) {
+            return MOV_PRODUTO_NAO_ENCONTRADO;
+        }
+
+        std::lock_guard<std::mutex> travaProduto(catalogo.fragmentos[slot & (NUM_FRAGMENTOS - 1)].mtx);
+        int32_t& saldo = catalogo.produtos.quantidades[slot];
+        if (!entrada && saldo < quantidade) {
+            if (resultado != NULL) {
+                *resultado = catalogo.produtos.produto(slot);
+            }
+            return MOV_SALDO_INSUFICIENTE;
+        }
+        if (entrada && quantidade > INT32_MAX - saldo) {
+            if (resultado != NULL) {
+                *resultado = catalogo.produtos.produto(slot);
+            }
+            return MOV_SALDO_EXCEDIDO;
+        }
+
+        // Os agregados trocam a contribuicao antiga do produto pela nova
+        contabilizarProduto(slot, -1);
+        saldo += entrada ? quantidade : -quantidade;
+        // Uma unica escrita sequencial no log registra a movimentacao;
+        // o arquivo de estoque so e reescrito no proximo checkpoint
+        if (!registrarMovimentacao(id, quantidade, saldo, entrada ? "ENTRADA" : "SAIDA", pendente)) {
+            saldo -= entrada ? quantidade : -quantidade;
+            contabilizarProduto(slot, +1);
+            return MOV_ERRO_LOG;
+        }
+        contabilizarProduto(slot, +1);
+        // No formato binario o registro do produto e atualizado no lugar; se
+        // a escrita falhar a linha do log continua valendo e o checkpoint
+        // regrava o arquivo inteiro
+        if (catalogo.usaBinario && !gravarRegistroBinario(slot, catalogo.produtos.produto(slot))) {
+            catalogo.registrosBinariosAtrasados = true;
+        }
+        if (resultado != NULL) {
+            *resultado = catalogo.produtos.produto(slot);
+        }
+    }
+
+    // A linha ja esta no log (e na ordem certa); so falta o flush. Se ele
+    // falhar a movimentacao continua aplicada: so nao ha garantia de disco
+    return confirmarMovimentacao(pendente) ? MOV_OK : MOV_NAO_CONFIRMADA;
+}
+
+// Altera o estoque minimo de um produto (registrado no log como MINIMO,
+// com o mesmo cuidado de travas de uma movimentacao)
+ResultadoMovimentacao definirEstoqueMinimo(int id, int minimo, Produto* resultado) {
+    if (minimo < 0) {
+        return MOV_QUANTIDADE_INVALIDA;
+    }
+
+    CommitPendente pendente;
+    {
+        std::shared_lock<std::shared_mutex> travaCatalogo(catalogo.mutexCatalogo);
+        int slot = catalogo.indice.buscar(id);
+        if (slot < 0) {
+            return MOV_PRODUTO_NAO_ENCONTRADO;
+        }
+
+        std::lock_guard<std::mutex> travaProduto(catalogo.fragmentos[slot & (NUM_FRAGMENTOS - 1)].mtx);
+        int32_t& estoqueMinimo = catalogo.produtos.estoquesMinimos[slot];
+        int anterior = estoqueMinimo;
+
+        contabilizarProduto(slot, -1);
+        estoqueMinimo = minimo;
+        if (!registrarMovimentacao(id, minimo, catalogo.produtos.quantidades[slot], "MINIMO", pendente)) {
+            estoqueMinimo = anterior;
+            contabilizarProduto(slot, +1);
+            return MOV_ERRO_LOG;
+        }
+        contabilizarProduto(slot, +1);
+
+        Produto p = catalogo.produtos.produto(slot);
+        if (catalogo.usaBinario && !gravarRegistroBinario(slot, p)) {
+            catalogo.registrosBinariosAtrasados = true;
+        }
+        if (resultado != NULL) {
+            *resultado = p;
+        }
+    }
+
+    return confirmarMovimentacao(pendente) ? MOV_OK : MOV_NAO_CONFIRMADA;
+}
+
+// 4. SYSTEM CALLS: Leitura, modificacao e escrita - Saida de mercadoria
+void darSaidaEmProduto() {
+    std::cout << "\n=== SAIDA DE MERCADORIA ===\n";
+    std::cout << "Digite o ID do produto: ";
+    int idProduto;
+    std::cin >> idProduto;
+    std::cout << "Digite a quantidade a ser retirada: ";
+    int quantidadeRetirada;
+    std::cin >> quantidadeRetirada;
+
+    garantirCatalogoAtualizado();
+    if (catalogo.produtos.vazio()) {
+        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
+        return;
+    }
+
+    Produto p;
+    switch (aplicarMovimentacao(idProduto, quantidadeRetirada, false, &p)) {
+        case MOV_OK:
+            std::cout << "? Retirada de " << quantidadeRetirada << " unidades de '" << p.nome << "' realizada com sucesso!" << std::endl;
+            break;
+        case MOV_PRODUTO_NAO_ENCONTRADO:
+            std::cout << "? Produto nao encontrado!" << std::endl;
+            break;
+        case MOV_QUANTIDADE_INVALIDA:
+            std::cout << "? Erro: A quantidade deve ser maior que zero." << std::endl;
+            break;
+        case MOV_SALDO_INSUFICIENTE:
+            std::cout << "? Erro: Quantidade insuficiente em estoque. Disponivel: " << p.quantidade << std::endl;
+            break;
+        case MOV_SALDO_EXCEDIDO:
+            break; // So acontece em ENTRADA
+        case MOV_ERRO_LOG:
+            std::cout << "? Erro: Movimentacao nao registrada. Estoque inalterado." << std::endl;
+            break;
+        case MOV_NAO_CONFIRMADA:
+            std::cout << "? Aviso: Movimentacao aplicada (saldo " << p.quantidade
+                      << "), mas nao confirmada no disco." << std::endl;
+            break;
+    }
+    realizarCheckpointSeNecessario();
+}
+
+// 5. SYSTEM CALLS: Leitura, modificacao e escrita - Entrada de mercadoria
+void darEntradaEmProduto() {
+    std::cout << "\n=== ENTRADA DE MERCADORIA ===\n";
+    std::cout << "Digite o ID do produto: ";
+    int idProduto;
+    std::cin >> idProduto;
+    std::cout << "Digite a quantidade a ser adicionada: ";
+    int quantidadeAdicionada;
+    std::cin >> quantidadeAdicionada;
+
+    garantirCatalogoAtualizado();
+    if (catalogo.produtos.vazio()) {
+        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
+        return;
+    }
+
+    Produto p;
+    switch (aplicarMovimentacao(idProduto, quantidadeAdicionada, true, &p)) {
+        case MOV_OK:
+            std::cout << "? Adicao de " << quantidadeAdicionada << " unidades de '" << p.nome << "' realizada com sucesso!" << std::endl;
+            break;
+        case MOV_PRODUTO_NAO_ENCONTRADO:
+            std::cout << "? Produto nao encontrado!" << std::endl;
+            break;
+        case MOV_QUANTIDADE_INVALIDA:
+        case MOV_SALDO_INSUFICIENTE:
+            std::cout << "? Erro: A quantidade deve ser maior que zero." << std::endl;
+            break;
+        case MOV_SALDO_EXCEDIDO:
+            std::cout << "? Erro: O saldo passaria do limite de " << INT32_MAX << " unidades. Atual: "
+                      << p.quantidade << std::endl;
+            break;
+        case MOV_ERRO_LOG:
+            std::cout << "? Erro: Movimentacao nao registrada. Estoque inalterado." << std::endl;
+            break;
+        case MOV_NAO_CONFIRMADA:
+            std::cout << "? Aviso: Movimentacao aplicada (saldo " << p.quantidade
+                      << "), mas nao confirmada no disco." << std::endl;
+            break;
+    }
+    realizarCheckpointSeNecessario();
+}
+
+// === SAIDA BUFFERIZADA ===
+// Buffer de saida que acumula texto e so chama WriteFile quando enche
+// (usado pelo relatorio e pelo modo lote)
+class BufferDeEscrita {
+public:
+    explicit BufferDeEscrita(HANDLE h) : hArquivo(h), falhou(false) { dados.reserve(CAPACIDADE); }
+    ~BufferDeEscrita() { descarregar(); }
+
+    void acrescentar(const char* texto, size_t tamanho) {
+        if (dados.size() + tamanho > CAPACIDADE) {
+            descarregar();
+        }
+        dados.append(texto, tamanho);
+    }
+
+    void acrescentar(const char* texto) { acrescentar(texto, strlen(texto)); }
+
+    bool descarregar() {
+        if (!dados.empty() && hArquivo != INVALID_HANDLE_VALUE) {
+            DWORD bytesEscritos = 0;
+            if (!WriteFile(hArquivo, dados.data(), (DWORD)dados.size(), &bytesEscritos, NULL) ||
+                bytesEscritos != dados.size()) {
+                falhou = true;
+            }
+        }
+        dados.clear();
+        return !falhou;
+    }
+
+    bool ok() const { return !falhou; }
+
+private:
+    static const size_t CAPACIDADE = 1 << 20; // 1 MB por WriteFile
+    HANDLE hArquivo;
+    std::string dados;
+    bool falhou;
+};
+
+// Data/hora no formato "AAAA-MM-DD HH:MM:SS"
+void formatarDataHora(const SYSTEMTIME& momento, char* destino, size_t tamanho) {
+    sprintf_s(destino, tamanho, "%04d-%02d-%02d %02d:%02d:%02d",
+              momento.wYear, momento.wMonth, momento.wDay, momento.wHour, momento.wMinute, momento.wSecond);
+}
+
+// === AGREGACAO DO RELATORIO ===
+// Totais de uma categoria (primeira palavra do nome do produto)
+struct ResumoCategoria {
+    long long produtos;
+    long long quantidade;
+    long long valorCentavos;
+    long long baixoEstoque;
+};
+
+// Resultado parcial de um pedaco do catalogo. Cada thread preenche o seu e
+// os parciais sao somados no fim, sem nenhuma trava durante a contagem.
+struct AgregadoRelatorio {
+    std::unordered_map<std::string, ResumoCategoria> categorias;
+    std::vector<int> baixoEstoque; // Slots dos produtos abaixo do minimo
+};
+
+// Categoria do produto: primeira palavra do nome, sem diferenciar
+// maiusculas/acentos ("Arroz Branco" e "ARROZ integral" caem em "ARROZ")
+static std::string categoriaDoProduto(const char* nome) {
+    std::string categoria = normalizarNome(nome);
+    size_t espaco = categoria.find(' ');
+    if (espaco != std::string::npos) {
+        categoria.resize(espaco);
+    }
+    for (auto& c : categoria) {
+        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    }
+    return categoria;
+}
+
+static void agregarPedaco(const ColunasProdutos& produtos, size_t inicio, size_t fim,
+                          AgregadoRelatorio& parcial) {
+    for (size_t i = inicio; i < fim; i++) {
+        ResumoCategoria& c = parcial.categorias.try_emplace(categoriaDoProduto(produtos.nome(i)),
+                                                            ResumoCategoria{0, 0, 0, 0}).first->second;
+        long long quantidade = produtos.quantidades[i];
+        c.produtos++;
+        c.quantidade += quantidade;
+        c.valorCentavos += quantidade * produtos.precosCentavos[i];
+        c.baixoEstoque += quantidade < produtos.estoquesMinimos[i];
+    }
+}
+
+// Divide o catalogo em um pedaco por nucleo e agrega os pedacos em paralelo.
+// Catalogos pequenos sao agregados na propria thread (criar threads custaria
+// mais que a contagem).
+static AgregadoRelatorio agregarRelatorio(const ColunasProdutos& produtos) {
+    size_t numThreads = pedacosParaThreads(produtos.tamanho(), 0);
+    std::vector<AgregadoRelatorio> parciais(numThreads);
+    executarEmPedacos(produtos.tamanho(), numThreads, [&](size_t t, size_t inicio, size_t fim) {
+        agregarPedaco(produtos, inicio, fim, parciais[t]);
+    });
+
+    // Junta os parciais no primeiro
+    AgregadoRelatorio& total = parciais[0];
+    for (size_t t = 1; t < numThreads; t++) {
+        for (const auto& par : parciais[t].categorias) {
+            ResumoCategoria& c = total.categorias.try_emplace(par.first, ResumoCategoria{0, 0, 0, 0}).first->second;
+            c.produtos += par.second.produtos;
+            c.quantidade += par.second.quantidade;
+            c.valorCentavos += par.second.valorCentavos;
+            c.baixoEstoque += par.second.baixoEstoque;
+        }
+    }
+    // A lista de baixo estoque sai direto das colunas pelo kernel de selecao
+    total.baixoEstoque = selecionarBaixoEstoque(produtos, kernelsEstoque());
+    return std::move(total);
+}
+
+// 6. SYSTEM CALLS: Criacao, leitura e escrita - Geracao de relatorio
+// O texto e formatado em um buffer de 1 MB reaproveitado e gravado em
+// poucas chamadas grandes de WriteFile (antes era uma por produto).
+void gerarRelatorio() {
+    std::cout << "\n=== GERANDO RELATORIO DO ESTOQUE ===\n";
+
+    garantirCatalogoAtualizado();
+    std::shared_lock<std::shared_mutex> trava(catalogo.mutexCatalogo);
+    const ColunasProdutos& produtos = catalogo.produtos;
+    if (produtos.vazio()) {
+        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
+        return;
+    }
+
+    // SYSTEM CALL: CreateFile - Cria o arquivo de relatorio
+    HANDLE hRelatorio = CreateFileA(
+        ARQUIVO_RELATORIO,
+        GENERIC_WRITE,
+        0,
+        NULL,
+        CREATE_ALWAYS,       // Sempre cria um novo arquivo, sobrescrevendo se existir
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+
+    if (hRelatorio == INVALID_HANDLE_VALUE) {
+        tratarErro("criar arquivo de relatorio");
+        return;
+    }
+
+    AgregadoRelatorio agregado = agregarRelatorio(produtos);
+
+    // Categorias em ordem alfabetica; baixo estoque do maior para o menor
+    // deficit (minimo - quantidade), empates pelo ID
+    std::vector<std::pair<std::string, ResumoCategoria>> categorias(agregado.categorias.begin(),
+                                                                    agregado.categorias.end());
+    std::sort(categorias.begin(), categorias.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::sort(agregado.baixoEstoque.begin(), agregado.baixoEstoque.end(), [&](int a, int b) {
+        int deficitA = produtos.estoquesMinimos[a] - produtos.quantidades[a];
+        int deficitB = produtos.estoquesMinimos[b] - produtos.quantidades[b];
+        return deficitA != deficitB ? deficitA > deficitB : produtos.ids[a] < produtos.ids[b];
+    });
+
+    // SYSTEM CALL: GetLocalTime - Data/hora de geracao do relatorio
+    SYSTEMTIME agora;
+    GetLocalTime(&agora);
+    char dataHora[64];
+    formatarDataHora(agora, dataHora, sizeof(dataHora));
+
+    // O resumo vem dos agregados mantidos a cada movimentacao: nao e preciso
+    // percorrer os produtos para calcula-lo
+    long long valorTotalCentavos = catalogo.valorTotalCentavos.load();
+    char linha[MAX_NOME + 160];
+    BufferDeEscrita relatorio(hRelatorio);
+
+    char cabecalho[1024];
+    sprintf_s(cabecalho, sizeof(cabecalho),
+              "=== RELATORIO DO ESTOQUE ===\n\n"
+              "Gerado em: %s\n"
+              "----------------------------------------\n"
+              "RESUMO\n"
+              "Total de tipos de produtos: %zu\n"
+              "Quantidade total de itens: %lld\n"
+              "Valor total do estoque: R$%lld.%02lld\n"
+              "Produtos abaixo do estoque minimo: %lld\n"
+              "----------------------------------------\n\n",
+              dataHora, produtos.tamanho(), catalogo.totalQuantidade.load(), valorTotalCentavos / 100,
+              llabs(valorTotalCentavos % 100), catalogo.produtosBaixoEstoque.load());
+    relatorio.acrescentar(cabecalho);
+
+    relatorio.acrescentar("RESUMO POR CATEGORIA\n");
+    for (const auto& par : categorias) {
+        const ResumoCategoria& c = par.second;
+        sprintf_s(linha, sizeof(linha), "%-20s | Produtos: %lld | Itens: %lld | Valor: R$%lld.%02lld | Abaixo do minimo: %lld\n",
+                  par.first.c_str(), c.produtos, c.quantidade, c.valorCentavos / 100, llabs(c.valorCentavos % 100),
+                  c.baixoEstoque);
+        relatorio.acrescentar(linha);
+    }
+    relatorio.acrescentar("----------------------------------------\n\n");
+
+    relatorio.acrescentar("PRODUTOS ABAIXO DO ESTOQUE MINIMO (maior falta primeiro)\n");
+    if (agregado.baixoEstoque.empty()) {
+        relatorio.acrescentar("Nenhum.\n");
+    }
+    for (int slot : agregado.baixoEstoque) {
+        int quantidade = produtos.quantidades[slot];
+        int minimo = produtos.estoquesMinimos[slot];
+        sprintf_s(linha, sizeof(linha), "ID: %d | Nome: %s | Qtd: %d | Min: %d | Faltam: %d\n",
+                  produtos.ids[slot], produtos.nome(slot), quantidade, minimo, minimo - quantidade);
+        relatorio.acrescentar(linha);
+    }
+    relatorio.acrescentar("----------------------------------------\n\n");
+
+    relatorio.acrescentar("LISTAGEM DETALHADA DE PRODUTOS\n");
+    for (size_t i = 0; i < produtos.tamanho(); i++) {
+        int tamanho = sprintf_s(linha, sizeof(linha), "ID: %d | Nome: %s | Qtd: %d | Min: %d | Preco: R$%.2f\n",
+                                produtos.ids[i], produtos.nome(i), produtos.quantidades[i],
+                                produtos.estoquesMinimos[i], produtos.preco(i));
+        relatorio.acrescentar(linha, tamanho);
+    }
+
+    // SYSTEM CALL: WriteFile - Grava o que restou no buffer
+    bool gravado = relatorio.descarregar();
+
+    // SYSTEM CALL: CloseHandle
+    CloseHandle(hRelatorio);
+    if (!gravado) {
+        tratarErro("gravar arquivo de relatorio");
+        return;
+    }
+    std::cout << "? Relatorio gerado em '" << ARQUIVO_RELATORIO << "'" << std::endl;
+}
+
+// === LEITURA DO ARQUIVO TEXTO MAPEADO EM MEMORIA ===
+// Arquivo aberto somente para leitura e mapeado no espaco de enderecamento do
+// processo. As linhas sao percorridas direto nas paginas mapeadas, sem
+// ReadFile para um buffer intermediario.
+class ArquivoMapeado {
+public:
+    explicit ArquivoMapeado(const char* nomeArquivo)
+        : hArquivo(INVALID_HANDLE_VALUE), hMapeamento(NULL), dados(NULL), tamanho(0), existe(false) {
+        // SYSTEM CALL: CreateFile - Abre o arquivo para leitura sequencial
+        hArquivo = CreateFileA(nomeArquivo, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (hArquivo == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        existe = true;
+
+        LARGE_INTEGER tamanhoArquivo;
+        if (!GetFileSizeEx(hArquivo, &tamanhoArquivo) || tamanhoArquivo.QuadPart == 0) {
+            return; // Arquivo vazio nao pode ser mapeado (e nao precisa)
+        }
+        tamanho = static_cast<size_t>(tamanhoArquivo.QuadPart);
+
+        // SYSTEM CALL: CreateFileMapping + MapViewOfFile - Mapeia o arquivo inteiro
+        hMapeamento = CreateFileMappingA(hArquivo, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMapeamento != NULL) {
+            dados = static_cast<const char*>(MapViewOfFile(hMapeamento, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (dados == NULL) {
+            tratarErro("mapear arquivo em memoria");
+            tamanho = 0;
+        }
+    }
+
+    ~ArquivoMapeado() {
+        if (dados != NULL) UnmapViewOfFile(dados);
+        if (hMapeamento != NULL) CloseHandle(hMapeamento);
+        if (hArquivo != INVALID_HANDLE_VALUE) CloseHandle(hArquivo);
+    }
+
+    ArquivoMapeado(const ArquivoMapeado&) = delete;
+    ArquivoMapeado& operator=(const ArquivoMapeado&) = delete;
+
+    bool aberto() const { return existe && (dados != NULL || tamanho == 0); }
+    const char* inicio() const { return dados; }
+    const char* fim() const { return dados + tamanho; }
+    size_t tamanhoBytes() const { return tamanho; }
+
+private:
+    HANDLE hArquivo;
+    HANDLE hMapeamento;
+    const char* dados;
+    size_t tamanho;
+    bool existe;
+};
+
+// Le um inteiro ocupando exatamente o intervalo [inicio, fim)
+static bool lerCampoInteiro(const char* inicio, const char* fim, int& valor) {
+    std::from_chars_result r = std::from_chars(inicio, fim, valor);
+    return r.ec == std::errc() && r.ptr == fim && inicio != fim;
+}
+
+// Le um numero real ocupando exatamente o intervalo [inicio, fim)
+static bool lerCampoReal(const char* inicio, const char* fim, double& valor) {
+    std::from_chars_result r = std::from_chars(inicio, fim, valor, std::chars_format::fixed);
+    return r.ec == std::errc() && r.ptr == fim && inicio != fim;
+}
+
+// Interpreta uma linha "id|nome|quantidade|preco" direto na memoria mapeada,
+// sem copiar, alocar ou interpretar string de formato. Retorna false se
+// faltar campo ou algum numero for invalido.
+static bool interpretarLinhaProduto(const char* inicio, const char* fim, ProdutoMapeado& produto) {
+    const char* campos[5];
+    campos[0] = inicio;
+    for (int i = 1; i < 4; i++) {
+        const char* separador = static_cast<const char*>(memchr(campos[i - 1], '|', fim - campos[i - 1]));
+        if (separador == NULL) {
+            return false;
+        }
+        campos[i] = separador + 1;
+    }
+    // Quinto campo opcional: estoque minimo do produto
+    const char* separadorMinimo = static_cast<const char*>(memchr(campos[3], '|', fim - campos[3]));
+    campos[4] = separadorMinimo != NULL ? separadorMinimo + 1 : fim + 1; // "+1" simula o separador
+
+    produto.estoqueMinimo = ESTOQUE_MINIMO_PADRAO;
+    if (separadorMinimo != NULL && !lerCampoInteiro(separadorMinimo + 1, fim, produto.estoqueMinimo)) {
+        return false;
+    }
+
+    produto.nome = std::string_view(campos[1], campos[2] - campos[1] - 1);
+    return lerCampoInteiro(campos[0], campos[1] - 1, produto.id) &&
+           !produto.nome.empty() &&
+           lerCampoInteiro(campos[2], campos[3] - 1, produto.quantidade) &&
+           lerCampoReal(campos[3], campos[4] - 1, produto.preco);
+}
+
+// Percorre as linhas nao vazias do arquivo mapeado (sem o '\n' e um
+// eventual '\r' final), chamando aoLer(inicio, fim, numeroDaLinha)
+template <typename Funcao>
+void percorrerLinhasMapeadas(const ArquivoMapeado& arquivo, Funcao aoLer) {
+    size_t numeroLinha = 0;
+    const char* cursor = arquivo.inicio();
+    const char* fimArquivo = arquivo.fim();
+
+    while (cursor < fimArquivo) {
+        const char* fimLinha = static_cast<const char*>(memchr(cursor, '\n', fimArquivo - cursor));
+        if (fimLinha == NULL) {
+            fimLinha = fimArquivo;
+        }
+        numeroLinha++;
+
+        const char* fimConteudo = fimLinha;
+        if (fimConteudo > cursor && fimConteudo[-1] == '\r') {
+            fimConteudo--;
+        }
+        if (fimConteudo > cursor) {
+            aoLer(cursor, fimConteudo, numeroLinha);
+        }
+        cursor = fimLinha + 1;
+    }
+}
+
+// Percorre todas as linhas do arquivo mapeado chamando 'aoLer' para cada
+// produto valido. Linhas mal formadas sao informadas (as primeiras) e
+// contadas, em vez de gerar um Produto com campos lixo.
+template <typename Funcao>
+size_t percorrerProdutosMapeados(const ArquivoMapeado& arquivo, const char* nomeArquivo, Funcao aoLer) {
+    const size_t MAX_AVISOS = 10;
+    size_t linhasInvalidas = 0;
+
+    percorrerLinhasMapeadas(arquivo, [&](const char* inicio, const char* fim, size_t numeroLinha) {
+        ProdutoMapeado produto;
+        if (interpretarLinhaProduto(inicio, fim, produto)) {
+            aoLer(produto);
+            return;
+        }
+        if (linhasInvalidas < MAX_AVISOS) {
+            std::cerr << "AVISO: linha " << numeroLinha << " de '" << nomeArquivo << "' mal formada: "
+                      << std::string_view(inicio, std::min<size_t>(fim - inicio, 60)) << std::endl;
+        }
+        linhasInvalidas++;
+    });
+
+    if (linhasInvalidas > MAX_AVISOS) {
+        std::cerr << "AVISO: " << linhasInvalidas << " linha(s) mal formada(s) ignorada(s) em '"
+                  << nomeArquivo << "'." << std::endl;
+    }
+    return linhasInvalidas;
+}
+
+// Funcao auxiliar para ler todos os produtos do arquivo texto para a memoria.
+// Retorna false se o arquivo nao existir ou nao puder ser mapeado.
+bool lerProdutosDoArquivo(ColunasProdutos& produtos) {
+    produtos = ColunasProdutos();
+    ArquivoMapeado arquivo(ARQUIVO_ESTOQUE);
+    if (!arquivo.aberto()) {
+        return false;
+    }
+
+    // Estimativa de ~24 bytes por linha (metade disso de nome) evita
+    // realocacoes durante a carga; o nome vai direto do mapeamento para o pool
+    produtos.reservar(arquivo.tamanhoBytes() / 24 + 1, arquivo.tamanhoBytes() / 2);
+    size_t precosInvalidos = 0;
+    int primeiroInvalido = 0;
+    percorrerProdutosMapeados(arquivo, ARQUIVO_ESTOQUE, [&](const ProdutoMapeado& lido) {
+        if (!precoCabeNaColuna(lido.preco)) {
+            if (precosInvalidos++ == 0) {
+                primeiroInvalido = lido.id;
+            }
+            return;
+        }
+        produtos.adicionar(lido.id, lido.nome, lido.quantidade, static_cast<int32_t>(precoEmCentavos(lido.preco)),
+                           lido.estoqueMinimo);
+    });
+    if (precosInvalidos > 0) {
+        std::cerr << "ERRO: " << precosInvalidos << " produto(s) com preco fora da faixa suportada (o primeiro e o ID "
+                  << primeiroInvalido << ") ignorado(s) em '" << ARQUIVO_ESTOQUE << "'." << std::endl;
+    }
+    return true;
+}
+
+// Funcao auxiliar para salvar todos os produtos de volta no arquivo.
+// Grava primeiro um arquivo temporario e depois o troca atomicamente pelo
+// arquivo de estoque: uma queda no meio da escrita nao corrompe o estoque.
+bool salvarProdutosNoArquivo(const ColunasProdutos& produtos) {
+    HANDLE hArquivo = CreateFileA(
+        ARQUIVO_ESTOQUE_TEMP,
+        GENERIC_WRITE,
+        0,
+        NULL,
+        CREATE_ALWAYS, // Sobrescreve um temporario que tenha sobrado
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        tratarErro("salvar dados no arquivo");
+        return false;
+    }
+
+    // Monta o conteudo em memoria e grava com uma unica chamada de WriteFile
+    std::string conteudo;
+    conteudo.reserve(produtos.tamanho() * 32);
+    for (size_t i = 0; i < produtos.tamanho(); i++) {
+        char linha[MAX_NOME + 50];
+        conteudo.append(linha, formatarLinhaProduto(linha, sizeof(linha), produtos.ids[i], produtos.nome(i),
+                                                    produtos.quantidades[i], produtos.preco(i),
+                                                    produtos.estoquesMinimos[i]));
+    }
+
+    DWORD bytesEscritos = 0;
+    BOOL sucesso = WriteFile(hArquivo, conteudo.data(), (DWORD)conteudo.size(), &bytesEscritos, NULL) &&
+                   bytesEscritos == conteudo.size();
+
+    // SYSTEM CALL: FlushFileBuffers - Garante que o temporario esta no disco antes da troca
+    sucesso = sucesso && FlushFileBuffers(hArquivo);
+    CloseHandle(hArquivo);
+
+    // SYSTEM CALL: MoveFileEx - Substitui o arquivo de estoque de forma atomica
+    if (!sucesso || !MoveFileExA(ARQUIVO_ESTOQUE_TEMP, ARQUIVO_ESTOQUE,
+                                 MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        tratarErro("salvar dados no arquivo");
+        return false;
+    }
+
+    // A escrita foi nossa: atualiza a assinatura para nao recarregar o catalogo
+    // (no formato binario o arquivo texto e apenas uma exportacao)
+    if (!catalogo.usaBinario) {
+        catalogo.assinatura = obterAssinaturaArquivo(ARQUIVO_ESTOQUE);
+    }
+    return true;
+}
+
+// Funcao auxiliar para registrar uma movimentacao no log (write-ahead log).
+// Cada registro e uma linha "seq|TIPO|id|quantidade|saldo|data" acrescentada
+// ao fim do arquivo (TIPO = ENTRADA, SAIDA ou MINIMO; no MINIMO a quantidade
+// e o novo estoque minimo). O saldo resultante e gravado junto, entao reaplicar o
+// mesmo registro duas vezes da o mesmo resultado.
+bool registrarMovimentacao(int id, int quantidade, int saldo, const std::string& tipo, CommitPendente& pendente) {
+    QueryPerformanceCounter(&pendente.inicio);
+
+    SYSTEMTIME agora;
+    GetLocalTime(&agora);
+    char dataHora[64];
+    formatarDataHora(agora, dataHora, sizeof(dataHora));
+
+    // Sequencia e escrita sob o mesmo mutex: o log fica em ordem de sequencia
+    std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+
+    char linha[160];
+    int tamanho = sprintf_s(linha, sizeof(linha), "%llu|%s|%d|%d|%d|%s\n",
+                            catalogo.proximaSequencia, tipo.c_str(), id, quantidade, saldo, dataHora);
+
+    if (!catalogo.escritorLog.acrescentar(linha, tamanho, pendente.ticket)) {
+        tratarErro("escrever no log de movimentacoes");
+        return false;
+    }
+
+    catalogo.historicoPendente.push_back(
+        registroHistorico(momentoHistorico(agora), id, quantidade, tipo.c_str()));
+    catalogo.proximaSequencia++;
+    catalogo.movimentacoesPendentes++;
+    catalogo.bytesLogProprios += static_cast<unsigned long long>(tamanho);
+    catalogo.assinaturaLogDesatualizada = true;
+    return true;
+}
+
+// Espera a linha chegar ao disco conforme o modo de durabilidade. Chamado
+// depois de soltar as travas do catalogo/produto: no modo em grupo, outras
+// movimentacoes (inclusive do mesmo produto) escrevem enquanto esta espera e
+// entram no mesmo FlushFileBuffers.
+bool confirmarMovimentacao(const CommitPendente& pendente) {
+    if (!catalogo.escritorLog.confirmar(pendente.ticket, pendente.inicio)) {
+        tratarErro("sincronizar log de movimentacoes");
+        return false;
+    }
+    return true;
+}
+
+void EscritorLog::configurar(ModoDurabilidade novoModo, int janelaMicrossegundos) {
+    modo = novoModo;
+    janelaMicros = std::max(0, janelaMicrossegundos);
+}
+
+// FILE_APPEND_DATA: toda escrita vai para o fim do arquivo, sem SetFilePointer.
+// Chamado com mutexCommit travado.
+bool EscritorLog::abrir() {
+    hLog = CreateFileA(
+        ARQUIVO_LOG_MOVIMENTACOES,
+        FILE_APPEND_DATA,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    return hLog != INVALID_HANDLE_VALUE;
+}
+
+bool EscritorLog::acrescentar(const char* linha, size_t tamanho, uint64_t& ticket) {
+    // A escrita fica fora de mutexCommit (nao espera o flush da lider); o
+    // handle nao fecha no meio porque fechar() tambem exige mutexArquivos
+    HANDLE handle;
+    {
+        std::lock_guard<std::mutex> trava(mutexCommit);
+        if (hLog == INVALID_HANDLE_VALUE && !abrir()) {
+            return false;
+        }
+        handle = hLog;
+    }
+
+    // SYSTEM CALL: WriteFile - Unica chamada por movimentacao (arquivo ja aberto)
+    DWORD bytesEscritos = 0;
+    if (!WriteFile(handle, linha, (DWORD)tamanho, &bytesEscritos, NULL) || bytesEscritos != tamanho) {
+        return false;
+    }
+    ticket = escritos.fetch_add(1) + 1;
+    return true;
+}
+
+bool EscritorLog::confirmar(uint64_t ticket, LARGE_INTEGER inicio) {
+    bool sucesso = true;
+
+    if (modo == DURABILIDADE_POR_MOVIMENTACAO) {
+        // Flush proprio; mutexCommit so serializa com fechar()/outros flushes.
+        // Se um checkpoint fechou o log entre a escrita e aqui, fechar() ja
+        // levou a linha ao disco (ou registrou a falha)
+        std::lock_guard<std::mutex> trava(mutexCommit);
+        if (duraveis < ticket && falhouAte < ticket) {
+            uint64_t alvo = escritos.load();
+            if (hLog != INVALID_HANDLE_VALUE && FlushFileBuffers(hLog)) {
+                duraveis = std::max(duraveis, alvo);
+            } else {
+                falhouAte = std::max(falhouAte, alvo);
+            }
+            totalFlushes++;
+            somaTamanhoGrupo++;
+            maiorGrupo = std::max<uint64_t>(maiorGrupo, 1);
+        }
+        sucesso = duraveis >= ticket;
+    } else if (modo == DURABILIDADE_GRUPO) {
+        std::unique_lock<std::mutex> trava(mutexCommit);
+        while (duraveis < ticket && falhouAte < ticket) {
+            if (liderAtiva) {
+                // Outra movimentacao ja esta juntando o grupo: espera por ela
+                commitConcluido.wait(trava);
+                continue;
+            }
+
+            // Esta movimentacao vira a lider do proximo grupo; o handle fica
+            // valido ate ela terminar (fechar() espera liderAtiva cair)
+            liderAtiva = true;
+            HANDLE handle = hLog;
+            trava.unlock();
+            if (janelaMicros > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(janelaMicros));
+            }
+            uint64_t alvo = escritos.load();
+            // SYSTEM CALL: FlushFileBuffers - Um flush por todas as linhas do grupo
+            BOOL flushOk = handle != INVALID_HANDLE_VALUE && FlushFileBuffers(handle);
+            trava.lock();
+
+            uint64_t anterior = std::max(duraveis, falhouAte);
+            if (flushOk) {
+                duraveis = std::max(duraveis, alvo);
+            } else {
+                falhouAte = std::max(falhouAte, alvo);
+            }
+            if (alvo > anterior) {
+                totalFlushes++;
+                somaTamanhoGrupo += alvo - anterior;
+                maiorGrupo = std::max(maiorGrupo, alvo - anterior);
+            }
+            liderAtiva = false;
+            commitConcluido.notify_all();
+        }
+        sucesso = duraveis >= ticket;
+    }
+
+    if (sucesso) {
+        registrarLatencia(inicio);
+    }
+    return sucesso;
+}
+
+void EscritorLog::fechar() {
+    // Uma lider pode estar no meio do flush (fora de mutexCommit)
+    std::unique_lock<std::mutex> trava(mutexCommit);
+    commitConcluido.wait(trava, [this] { return !liderAtiva; });
+    if (hLog != INVALID_HANDLE_VALUE) {
+        // Nada escrito se perde: o que ainda nao foi confirmado vai ao disco
+        if (modo != DURABILIDADE_NENHUMA) {
+            uint64_t alvo = escritos.load();
+            if (FlushFileBuffers(hLog)) {
+                duraveis = std::max(duraveis, alvo);
+            } else {
+                falhouAte = std::max(falhouAte, alvo);
+            }
+        }
+        CloseHandle(hLog);
+        hLog = INVALID_HANDLE_VALUE;
+    }
+}
+
+// Latencia do commit (da formatacao da linha ate a confirmacao), em faixas
+// de potencia de 2 de microssegundos
+void EscritorLog::registrarLatencia(LARGE_INTEGER inicio) {
+    LARGE_INTEGER fim, frequencia;
+    QueryPerformanceCounter(&fim);
+    QueryPerformanceFrequency(&frequencia);
+    uint64_t micros = static_cast<uint64_t>((fim.QuadPart - inicio.QuadPart) * 1000000 / frequencia.QuadPart);
+
+    int faixa = 0;
+    while (faixa < FAIXAS_LATENCIA - 1 && (1ull << faixa) <= micros) {
+        faixa++;
+    }
+    latencias[faixa].fetch_add(1, std::memory_order_relaxed);
+    totalCommits.fetch_add(1, std::memory_order_relaxed);
+    somaLatenciaMicros.fetch_add(micros, std::memory_order_relaxed);
+
+    uint64_t maior = maiorLatenciaMicros.load(std::memory_order_relaxed);
+    while (micros > maior && !maiorLatenciaMicros.compare_exchange_weak(maior, micros)) {
+    }
+}
+
+// Percentil aproximado pelo limite superior da faixa do histograma
+double EscritorLog::percentilLatencia(double fracao) {
+    uint64_t total = totalCommits.load();
+    uint64_t acumulado = 0;
+    for (int i = 0; i < FAIXAS_LATENCIA; i++) {
+        acumulado += latencias[i].load();
+        if (total > 0 && acumulado >= fracao * total) {
+            return static_cast<double>(1ull << i);
+        }
+    }
+    return 0.0;
+}
+
+std::string EscritorLog::resumoEstatisticas() {
+    uint64_t commits = totalCommits.load();
+    uint64_t flushes, grupos, maior;
+    {
+        std::lock_guard<std::mutex> trava(mutexCommit);
+        flushes = totalFlushes;
+        grupos = somaTamanhoGrupo;
+        maior = maiorGrupo;
+    }
+
+    char texto[400];
+    sprintf_s(texto, sizeof(texto),
+              "durabilidade %s (janela %d us) | commits %llu | latencia media %.1f us, p50 <= %.0f us, "
+              "p99 <= %.0f us, maxima %llu us | flushes %llu | grupo medio %.2f, maior %llu",
+              nomeDoModo(modo), janelaMicros, (unsigned long long)commits,
+              commits > 0 ? static_cast<double>(somaLatenciaMicros.load()) / commits : 0.0,
+              percentilLatencia(0.50), percentilLatencia(0.99), (unsigned long long)maiorLatenciaMicros.load(),
+              (unsigned long long)flushes, flushes > 0 ? static_cast<double>(grupos) / flushes : 0.0,
+              (unsigned long long)maior);
+    return texto;
+}
+
+void EscritorLog::exibirEstatisticas() {
+    if (totalCommits.load() > 0) {
+        std::cout << "Log de movimentacoes: " << resumoEstatisticas() << std::endl;
+    }
+}
+
+// Faz o checkpoint quando o log acumulou LIMITE_CHECKPOINT movimentacoes.
+// Chamado fora das travas da movimentacao: o checkpoint precisa do catalogo
+// com exclusividade (nenhuma movimentacao em andamento).
+void realizarCheckpointSeNecessario() {
+    {
+        std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+        if (catalogo.movimentacoesPendentes < LIMITE_CHECKPOINT) {
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> travaCatalogo(catalogo.mutexCatalogo);
+    if (catalogo.movimentacoesPendentes >= LIMITE_CHECKPOINT) {
+        realizarCheckpoint();
+    }
+}
+
+// Reaplica sobre o catalogo (ja carregado do checkpoint) as movimentacoes
+// registradas no log. Um registro incompleto no fim do arquivo (queda no
+// meio de uma escrita) e descartado.
+void reaplicarLogDeMovimentacoes() {
+    catalogo.movimentacoesPendentes = 0;
+    catalogo.registrosBinariosAtrasados = false; // As colunas acabaram de sair do arquivo
+    // O log e a fonte das movimentacoes pendentes do historico
+    catalogo.historicoPendente.clear();
+
+    HANDLE hArquivo = CreateFileA(
+        ARQUIVO_LOG_MOVIMENTACOES,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        return; // Sem log: o checkpoint ja esta completo
+    }
+
+    DWORD tamanhoArquivo = GetFileSize(hArquivo, NULL);
+    if (tamanhoArquivo == 0) {
+        CloseHandle(hArquivo);
+        return;
+    }
+
+    char* buffer = new char[tamanhoArquivo + 1];
+    DWORD bytesLidos = 0;
+    ReadFile(hArquivo, buffer, tamanhoArquivo, &bytesLidos, NULL);
+    buffer[bytesLidos] = '\0';
+
+    // Tudo depois do ultimo '\n' e um registro incompleto
+    DWORD fimValido = bytesLidos;
+    while (fimValido > 0 && buffer[fimValido - 1] != '\n') {
+        fimValido--;
+    }
+    if (fimValido < bytesLidos) {
+        // SYSTEM CALL: SetEndOfFile - Corta o registro incompleto
+        SetFilePointer(hArquivo, (LONG)fimValido, NULL, FILE_BEGIN);
+        SetEndOfFile(hArquivo);
+        buffer[fimValido] = '\0';
+        std::cerr << "AVISO: registro incompleto descartado do fim de '"
+                  << ARQUIVO_LOG_MOVIMENTACOES << "'." << std::endl;
+    }
+    CloseHandle(hArquivo);
+
+    int ignorados = 0;
+    bool alterouProdutos = false;
+    char* linha = strtok(buffer, "\n");
+    while (linha != NULL) {
+        unsigned long long sequencia;
+        char tipo[16];
+        int id, quantidade, saldo;
+        SYSTEMTIME data;
+        memset(&data, 0, sizeof(data));
+        int ano, mes, dia, hora, minuto, segundo;
+        int lidos = sscanf_s(linha, "%llu|%15[^|]|%d|%d|%d|%d-%d-%d %d:%d:%d", &sequencia, tipo, (int)sizeof(tipo),
+                             &id, &quantidade, &saldo, &ano, &mes, &dia, &hora, &minuto, &segundo);
+        if (lidos >= 5) {
+            if (lidos == 11) {
+                data.wYear = (WORD)ano; data.wMonth = (WORD)mes; data.wDay = (WORD)dia;
+                data.wHour = (WORD)hora; data.wMinute = (WORD)minuto; data.wSecond = (WORD)segundo;
+            } else {
+                GetLocalTime(&data); // Registro sem data: assume o momento da reaplicacao
+            }
+            catalogo.historicoPendente.push_back(registroHistorico(momentoHistorico(data), id, quantidade, tipo));
+            int slot = buscarSlotPorId(id);
+            if (slot >= 0) {
+                // MINIMO guarda o novo limite no campo da quantidade
+                if (strcmp(tipo, "MINIMO") == 0) {
+                    catalogo.produtos.estoquesMinimos[slot] = quantidade;
+                } else {
+                    catalogo.produtos.quantidades[slot] = saldo;
+                }
+                alterouProdutos = true;
+            } else {
+                ignorados++;
+            }
+            if (sequencia >= catalogo.proximaSequencia) {
+                catalogo.proximaSequencia = sequencia + 1;
+            }
+            catalogo.movimentacoesPendentes++;
+        } else {
+            ignorados++;
+        }
+        linha = strtok(NULL, "\n");
+    }
+
+    if (ignorados > 0) {
+        std::cerr << "AVISO: " << ignorados << " registro(s) do log de movimentacoes ignorado(s)." << std::endl;
+    }
+    // As movimentacoes reaplicadas so estao nas colunas: no formato binario
+    // o proximo checkpoint precisa grava-las antes de esvaziar o log
+    if (catalogo.usaBinario && alterouProdutos) {
+        catalogo.registrosBinariosAtrasados = true;
+    }
+    delete[] buffer;
+}
+
+// Checkpoint: grava o estado atual do catalogo no arquivo de estoque e so
+// entao esvazia o log. Se o programa cair entre as duas etapas, o log e
+// reaplicado sobre o novo checkpoint sem efeito (os registros guardam o saldo).
+bool realizarCheckpoint() {
+    if (catalogo.usaBinario) {
+        // Normalmente os registros ja foram atualizados no lugar e basta
+        // garantir que estao no disco antes de descartar o log. Se o arquivo
+        // esta atras das colunas, todos sao regravados antes; enquanto isso
+        // falhar, o log nao e esvaziado.
+        if (catalogo.registrosBinariosAtrasados && !regravarRegistrosBinarios()) {
+            return false;
+        }
+        if (catalogo.hBinario == INVALID_HANDLE_VALUE || !FlushFileBuffers(catalogo.hBinario)) {
+            tratarErro("sincronizar arquivo binario de estoque");
+            return false;
+        }
+        catalogo.registrosBinariosAtrasados = false;
+    } else if (!salvarProdutosNoArquivo(catalogo.produtos)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+    if (catalogo.usaBinario) {
+        // Uma unica releitura da assinatura cobre todas as escritas no lugar
+        // desde o ultimo checkpoint
+        catalogo.assinatura = obterAssinaturaArquivo(ARQUIVO_ESTOQUE_BINARIO);
+        catalogo.assinaturaDesatualizada = false;
+    }
+
+    // As movimentacoes do log vao para o historico antes de o log ser
+    // esvaziado. Uma queda entre as duas etapas pode repetir estes registros
+    // no historico, mas nunca perde-los.
+    if (!gravarHistorico(catalogo.historicoPendente)) {
+        return false;
+    }
+    catalogo.historicoPendente.clear();
+
+    // CREATE_ALWAYS trunca o log para tamanho zero (o escritor fecha o seu
+    // handle antes e reabre na proxima movimentacao)
+    catalogo.escritorLog.fechar();
+    HANDLE hArquivo = CreateFileA(
+        ARQUIVO_LOG_MOVIMENTACOES,
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        tratarErro("truncar log de movimentacoes");
+        return false;
+    }
+    CloseHandle(hArquivo);
+
+    catalogo.movimentacoesPendentes = 0;
+    catalogo.assinaturaLog = obterAssinaturaArquivo(ARQUIVO_LOG_MOVIMENTACOES);
+    catalogo.bytesLogProprios = 0;
+    return true;
+}
+
+// Converte um Produto para o registro binario (bytes nao usados zerados)
+static RegistroProduto paraRegistro(const Produto& produto) {
+    RegistroProduto registro;
+    memset(&registro, 0, sizeof(registro));
+    registro.id = produto.id;
+    registro.quantidade = produto.quantidade;
+    registro.preco = produto.preco;
+    registro.estoqueMinimo = produto.estoqueMinimo;
+    strncpy_s(registro.nome, produto.nome, MAX_NOME - 1);
+    return registro;
+}
+
+// Mesmo registro montado direto das colunas (gravacao do arquivo inteiro)
+static RegistroProduto paraRegistro(const ColunasProdutos& produtos, size_t slot) {
+    RegistroProduto registro;
+    memset(&registro, 0, sizeof(registro));
+    registro.id = produtos.ids[slot];
+    registro.quantidade = produtos.quantidades[slot];
+    registro.preco = produtos.preco(slot);
+    registro.estoqueMinimo = produtos.estoquesMinimos[slot];
+    strncpy_s(registro.nome, produtos.nome(slot), MAX_NOME - 1);
+    return registro;
+}
+
+// Offset de 64 bits repartido nos campos da estrutura OVERLAPPED
+static OVERLAPPED offsetPara(uint64_t offset) {
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFu);
+    ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    return ov;
+}
+
+// Le estoque.dat validando assinatura, versao e tamanho do registro
+bool lerProdutosDoArquivoBinario(ColunasProdutos& produtos) {
+    HANDLE hArquivo = CreateFileA(
+        ARQUIVO_ESTOQUE_BINARIO,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        tratarErro("abrir arquivo binario de estoque");
+        return false;
+    }
+
+    CabecalhoEstoque cabecalho;
+    DWORD bytesLidos = 0;
+    if (!ReadFile(hArquivo, &cabecalho, sizeof(cabecalho), &bytesLidos, NULL) || bytesLidos != sizeof(cabecalho) ||
+        memcmp(cabecalho.assinatura, ASSINATURA_BINARIO, sizeof(ASSINATURA_BINARIO)) != 0) {
+        std::cerr << "ERRO: '" << ARQUIVO_ESTOQUE_BINARIO << "' nao e um arquivo de estoque valido." << std::endl;
+        CloseHandle(hArquivo);
+        return false;
+    }
+    // Versao 1 e aceita para ser migrada logo abaixo; 0 (cabecalho zerado) ou
+    // qualquer versao desconhecida e rejeitada
+    if (cabecalho.versao < 1 || cabecalho.versao > VERSAO_BINARIO ||
+        cabecalho.tamanhoRegistro != sizeof(RegistroProduto)) {
+        std::cerr << "ERRO: versao " << cabecalho.versao << " do formato binario nao suportada." << std::endl;
+        CloseHandle(hArquivo);
+        return false;
+    }
+
+    // Um cadastro interrompido pode deixar o contador do cabecalho atras do
+    // tamanho do arquivo (ou vice-versa): vale o menor dos dois
+    LARGE_INTEGER tamanhoArquivo;
+    if (!GetFileSizeEx(hArquivo, &tamanhoArquivo)) {
+        tratarErro("obter tamanho do arquivo binario");
+        CloseHandle(hArquivo);
+        return false;
+    }
+    uint64_t registrosNoArquivo = (static_cast<uint64_t>(tamanhoArquivo.QuadPart) - TAMANHO_CABECALHO) / sizeof(RegistroProduto);
+    uint64_t quantidade = std::min<uint64_t>(cabecalho.quantidadeRegistros, registrosNoArquivo);
+
+    std::vector<RegistroProduto> registros(static_cast<size_t>(quantidade));
+    uint64_t bytesTotal = quantidade * sizeof(RegistroProduto);
+    uint64_t lidosTotal = 0;
+    while (lidosTotal < bytesTotal) {
+        DWORD bloco = static_cast<DWORD>(std::min<uint64_t>(bytesTotal - lidosTotal, 64u * 1024 * 1024));
+        if (!ReadFile(hArquivo, reinterpret_cast<char*>(registros.data()) + lidosTotal, bloco, &bytesLidos, NULL) ||
+            bytesLidos == 0) {
+            break;
+        }
+        lidosTotal += bytesLidos;
+    }
+    CloseHandle(hArquivo);
+
+    produtos = ColunasProdutos();
+    produtos.reservar(registros.size(), registros.size() * 16);
+    size_t precosInvalidos = 0;
+    int primeiroInvalido = 0;
+    for (size_t i = 0; i < lidosTotal / sizeof(RegistroProduto); i++) {
+        const RegistroProduto& r = registros[i];
+        if (!precoCabeNaColuna(r.preco)) {
+            if (precosInvalidos++ == 0) {
+                primeiroInvalido = r.id;
+            }
+            continue;
+        }
+        produtos.adicionar(r.id, std::string_view(r.nome, strnlen(r.nome, MAX_NOME)), r.quantidade,
+                           static_cast<int32_t>(precoEmCentavos(r.preco)),
+                           cabecalho.versao >= 2 ? r.estoqueMinimo : ESTOQUE_MINIMO_PADRAO);
+    }
+
+    // Sem os registros recusados os slots nao batem mais com as posicoes no
+    // arquivo (as escritas posicionadas iriam para o registro errado): o
+    // arquivo e regravado com as colunas, como na migracao
+    if (precosInvalidos > 0) {
+        std::cerr << "ERRO: " << precosInvalidos << " produto(s) com preco fora da faixa suportada (o primeiro e o ID "
+                  << primeiroInvalido << ") removido(s) de '" << ARQUIVO_ESTOQUE_BINARIO << "'." << std::endl;
+        return salvarProdutosNoArquivoBinario(produtos);
+    }
+
+    // Migra um arquivo de versao anterior para a versao atual: os registros
+    // antigos nao tem o campo de estoque minimo preenchido
+    if (cabecalho.versao < VERSAO_BINARIO) {
+        std::cout << "Migrando '" << ARQUIVO_ESTOQUE_BINARIO << "' da versao " << cabecalho.versao
+                  << " para a versao " << VERSAO_BINARIO << "..." << std::endl;
+        return salvarProdutosNoArquivoBinario(produtos);
+    }
+    return true;
+}
+
+// Grava estoque.dat completo (via temporario + troca atomica)
+bool salvarProdutosNoArquivoBinario(const ColunasProdutos& produtos) {
+    HANDLE hArquivo = CreateFileA(
+        ARQUIVO_ESTOQUE_BINARIO_TEMP,
+        GENERIC_WRITE,
+        0,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        tratarErro("criar arquivo binario de estoque");
+        return false;
+    }
+
+    CabecalhoEstoque cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    memcpy(cabecalho.assinatura, ASSINATURA_BINARIO, sizeof(ASSINATURA_BINARIO));
+    cabecalho.versao = VERSAO_BINARIO;
+    cabecalho.tamanhoRegistro = sizeof(RegistroProduto);
+    cabecalho.quantidadeRegistros = produtos.tamanho();
+
+    DWORD bytesEscritos = 0;
+    BOOL sucesso = WriteFile(hArquivo, &cabecalho, sizeof(cabecalho), &bytesEscritos, NULL);
+
+    // Grava os registros em blocos para nao fazer uma chamada por produto
+    std::vector<RegistroProduto> bloco;
+    bloco.reserve(8192);
+    for (size_t i = 0; sucesso && i < produtos.tamanho(); i++) {
+        bloco.push_back(paraRegistro(produtos, i));
+        if (bloco.size() == bloco.capacity() || i + 1 == produtos.tamanho()) {
+            DWORD tamanho = static_cast<DWORD>(bloco.size() * sizeof(RegistroProduto));
+            sucesso = WriteFile(hArquivo, bloco.data(), tamanho, &bytesEscritos, NULL) && bytesEscritos == tamanho;
+            bloco.clear();
+        }
+    }
+
+    sucesso = sucesso && FlushFileBuffers(hArquivo);
+    CloseHandle(hArquivo);
+
+    if (!sucesso || !MoveFileExA(ARQUIVO_ESTOQUE_BINARIO_TEMP, ARQUIVO_ESTOQUE_BINARIO,
+                                 MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        tratarErro("salvar arquivo binario de estoque");
+        return false;
+    }
+    return true;
+}
+
+// Abre estoque.dat para as escritas posicionadas das movimentacoes
+bool abrirArquivoBinario() {
+    fecharArquivoBinario();
+    catalogo.hBinario = CreateFileA(
+        ARQUIVO_ESTOQUE_BINARIO,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (catalogo.hBinario == INVALID_HANDLE_VALUE) {
+        tratarErro("abrir arquivo binario de estoque");
+        return false;
+    }
+    return true;
+}
+
+void fecharArquivoBinario() {
+    if (catalogo.hBinario != INVALID_HANDLE_VALUE) {
+        CloseHandle(catalogo.hBinario);
+        catalogo.hBinario = INVALID_HANDLE_VALUE;
+    }
+}
+
+// SYSTEM CALL: WriteFile com OVERLAPPED - Reescreve somente o registro do slot
+bool gravarRegistroBinario(int slot, const Produto& produto) {
+    if (catalogo.hBinario == INVALID_HANDLE_VALUE || slot < 0) {
+        return false;
+    }
+
+    RegistroProduto registro = paraRegistro(produto);
+    OVERLAPPED ov = offsetPara(TAMANHO_CABECALHO + static_cast<uint64_t>(slot) * sizeof(RegistroProduto));
+    DWORD bytesEscritos = 0;
+    if (!WriteFile(catalogo.hBinario, &registro, sizeof(registro), &bytesEscritos, &ov) ||
+        bytesEscritos != sizeof(registro)) {
+        tratarErro("atualizar registro no arquivo binario");
+        return false;
+    }
+    // Sem trava global nem stat por movimentacao: a assinatura e relida
+    // depois, uma vez para todas as escritas
+    catalogo.assinaturaDesatualizada = true;
+    return true;
+}
+
+// Regrava, no arquivo ja aberto, todos os registros a partir das colunas e
+// o cabecalho (em blocos, como na gravacao completa do arquivo)
+bool regravarRegistrosBinarios() {
+    if (catalogo.hBinario == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    const ColunasProdutos& produtos = catalogo.produtos;
+    std::vector<RegistroProduto> bloco;
+    bloco.reserve(8192);
+    uint64_t offset = TAMANHO_CABECALHO;
+    for (size_t i = 0; i < produtos.tamanho(); i++) {
+        bloco.push_back(paraRegistro(produtos, i));
+        if (bloco.size() == bloco.capacity() || i + 1 == produtos.tamanho()) {
+            DWORD tamanho = static_cast<DWORD>(bloco.size() * sizeof(RegistroProduto));
+            OVERLAPPED ov = offsetPara(offset);
+            DWORD bytesEscritos = 0;
+            if (!WriteFile(catalogo.hBinario, bloco.data(), tamanho, &bytesEscritos, &ov) ||
+                bytesEscritos != tamanho) {
+                tratarErro("regravar registros do arquivo binario");
+                return false;
+            }
+            offset += tamanho;
+            bloco.clear();
+        }
+    }
+    return gravarCabecalhoBinario(produtos.tamanho());
+}
+
+// Atualiza o contador de registros do cabecalho (offset 0)
+bool gravarCabecalhoBinario(uint64_t quantidadeRegistros) {
+    if (catalogo.hBinario == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    CabecalhoEstoque cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    memcpy(cabecalho.assinatura, ASSINATURA_BINARIO, sizeof(ASSINATURA_BINARIO));
+    cabecalho.versao = VERSAO_BINARIO;
+    cabecalho.tamanhoRegistro = sizeof(RegistroProduto);
+    cabecalho.quantidadeRegistros = quantidadeRegistros;
+
+    OVERLAPPED ov = offsetPara(0);
+    DWORD bytesEscritos = 0;
+    if (!WriteFile(catalogo.hBinario, &cabecalho, sizeof(cabecalho), &bytesEscritos, &ov) ||
+        bytesEscritos != sizeof(cabecalho)) {
+        tratarErro("atualizar cabecalho do arquivo binario");
+        return false;
+    }
+    std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+    catalogo.assinatura = obterAssinaturaArquivo(ARQUIVO_ESTOQUE_BINARIO);
+    catalogo.assinaturaDesatualizada = false;
+    return true;
+}
+
+// 7. Conversao entre o formato texto (estoque.txt) e o binario (estoque.dat)
+void converterEstoque() {
+    std::cout << "\n=== CONVERTER ESTOQUE ===\n";
+    std::cout << "1. Importar '" << ARQUIVO_ESTOQUE << "' para '" << ARQUIVO_ESTOQUE_BINARIO << "'\n";
+    std::cout << "2. Exportar '" << ARQUIVO_ESTOQUE_BINARIO << "' para '" << ARQUIVO_ESTOQUE << "'\n";
+    std::cout << "Escolha uma opcao: ";
+    int opcao;
+    std::cin >> opcao;
+    std::cin.ignore();
+
+    garantirCatalogoAtualizado();
+
+    if (opcao == 1) {
+        if (catalogo.usaBinario) {
+            std::cout << "? O estoque ja esta no formato binario." << std::endl;
+            return;
+        }
+        // O catalogo ja inclui o log reaplicado; depois da troca o log pode
+        // ser descartado (o checkpoint passa a ser o arquivo binario)
+        if (!salvarProdutosNoArquivoBinario(catalogo.produtos)) {
+            return;
+        }
+        catalogo.carregado = false;
+        garantirCatalogoAtualizado();
+        realizarCheckpoint();
+        std::cout << "? " << catalogo.produtos.tamanho() << " produto(s) importado(s) para '"
+                  << ARQUIVO_ESTOQUE_BINARIO << "'." << std::endl;
+    } else if (opcao == 2) {
+        if (!catalogo.usaBinario) {
+            std::cout << "? Nao existe '" << ARQUIVO_ESTOQUE_BINARIO << "' para exportar." << std::endl;
+            return;
+        }
+        if (salvarProdutosNoArquivo(catalogo.produtos)) {
+            std::cout << "? " << catalogo.produtos.tamanho() << " produto(s) exportado(s) para '"
+                      << ARQUIVO_ESTOQUE << "'." << std::endl;
+        }
+    } else {
+        std::cout << "? Opcao invalida!" << std::endl;
+    }
+}
+
+// 8. Definicao do estoque minimo de um produto
+void configurarEstoqueMinimo() {
+    std::cout << "\n=== ESTOQUE MINIMO ===\n";
+    std::cout << "Digite o ID do produto: ";
+    int idProduto;
+    std::cin >> idProduto;
+    std::cout << "Novo estoque minimo: ";
+    int minimo;
+    std::cin >> minimo;
+    std::cin.ignore();
+
+    garantirCatalogoAtualizado();
+    Produto p;
+    switch (definirEstoqueMinimo(idProduto, minimo, &p)) {
+        case MOV_OK:
+            std::cout << "? Estoque minimo de '" << p.nome << "' alterado para " << p.estoqueMinimo << "." << std::endl;
+            break;
+        case MOV_PRODUTO_NAO_ENCONTRADO:
+            std::cout << "? Produto nao encontrado!" << std::endl;
+            break;
+        case MOV_QUANTIDADE_INVALIDA:
+            std::cout << "? Erro: O estoque minimo nao pode ser negativo." << std::endl;
+            break;
+        case MOV_NAO_CONFIRMADA:
+            std::cout << "? Aviso: Estoque minimo de '" << p.nome << "' alterado para " << p.estoqueMinimo
+                      << ", mas nao confirmado no disco." << std::endl;
+            break;
+        default:
+            std::cout << "? Erro: Alteracao nao registrada." << std::endl;
+            break;
+    }
+    realizarCheckpointSeNecessario();
+}
+
+// 9. Verificacao: recalcula os totais percorrendo todos os produtos e
+// compara com os agregados incrementais. Retorna 0 se conferem.
+int verificarAgregados() {
+    std::cout << "\n=== VERIFICACAO DOS TOTAIS ===\n";
+    garantirCatalogoAtualizado();
+
+    std::shared_lock<std::shared_mutex> trava(catalogo.mutexCatalogo);
+    const KernelsEstoque& kernels = kernelsEstoque();
+    LARGE_INTEGER inicio, meio, fim, frequencia;
+    QueryPerformanceFrequency(&frequencia);
+    QueryPerformanceCounter(&inicio);
+    TotaisEstoque recalculado = totalizarColunas(catalogo.produtos, kernels);
+    QueryPerformanceCounter(&meio);
+    // Referencia: kernel escalar em uma unica thread
+    TotaisEstoque escalar = totalizarColunas(catalogo.produtos, KERNELS_ESCALAR, 1);
+    QueryPerformanceCounter(&fim);
+    size_t baixoSelecionados = selecionarBaixoEstoque(catalogo.produtos, kernels).size();
+    TotaisEstoque incremental = {catalogo.totalQuantidade.load(), catalogo.valorTotalCentavos.load(),
+                                 catalogo.produtosBaixoEstoque.load()};
+
+    bool confere = recalculado.quantidade == incremental.quantidade &&
+                   recalculado.valorCentavos == incremental.valorCentavos &&
+                   recalculado.baixoEstoque == incremental.baixoEstoque &&
+                   escalar.quantidade == recalculado.quantidade &&
+                   escalar.valorCentavos == recalculado.valorCentavos &&
+                   escalar.baixoEstoque == recalculado.baixoEstoque &&
+                   static_cast<long long>(baixoSelecionados) == recalculado.baixoEstoque;
+
+    printf("%-28s %18s %18s\n", "", "Incremental", "Recalculado");
+    printf("%-28s %18lld %18lld\n", "Quantidade total", incremental.quantidade, recalculado.quantidade);
+    printf("%-28s %18lld %18lld\n", "Valor total (centavos)", incremental.valorCentavos, recalculado.valorCentavos);
+    printf("%-28s %18lld %18lld\n", "Abaixo do estoque minimo", incremental.baixoEstoque, recalculado.baixoEstoque);
+    printf("Recalculo: kernel %s em %.3f ms | escalar (1 thread) em %.3f ms | selecao: %zu abaixo do minimo\n",
+           kernels.nome, (meio.QuadPart - inicio.QuadPart) * 1000.0 / frequencia.QuadPart,
+           (fim.QuadPart - meio.QuadPart) * 1000.0 / frequencia.QuadPart, baixoSelecionados);
+    printf("Catalogo em memoria: %zu produtos, %.1f MB em colunas + nomes\n", catalogo.produtos.tamanho(),
+           catalogo.produtos.bytesEmUso() / (1024.0 * 1024.0));
+    printf("%s\n", confere ? "? Os totais conferem." : "? DIVERGENCIA entre os totais incrementais e o recalculo!");
+    fflush(stdout);
+    return confere ? 0 : 1;
+}
+
+// === HISTORICO BINARIO DE MOVIMENTACOES ===
+// Dias corridos desde 1970-01-01 para uma data do calendario gregoriano
+static int64_t diasDesdeEpoca(int ano, int mes, int dia) {
+    ano -= mes <= 2;
+    const int64_t era = (ano >= 0 ? ano : ano - 399) / 400;
+    const int64_t anoDaEra = ano - era * 400;
+    const int64_t diaDoAno = (153 * (mes + (mes > 2 ? -3 : 9)) + 2) / 5 + dia - 1;
+    const int64_t diaDaEra = anoDaEra * 365 + anoDaEra / 4 - anoDaEra / 100 + diaDoAno;
+    return era * 146097 + diaDaEra - 719468;
+}
+
+static const int64_t DIAS_ATE_2000 = 10957; // diasDesdeEpoca(2000, 1, 1)
+
+// Momento do historico: segundos desde 2000-01-01 00:00:00 (cabe em 32 bits
+// ate o ano 2136)
+uint32_t momentoHistorico(const SYSTEMTIME& data) {
+    int64_t dias = diasDesdeEpoca(data.wYear, data.wMonth, data.wDay) - DIAS_ATE_2000;
+    int64_t segundos = dias * 86400 + data.wHour * 3600 + data.wMinute * 60 + data.wSecond;
+    return static_cast<uint32_t>(std::max<int64_t>(0, std::min<int64_t>(segundos, UINT32_MAX)));
+}
+
+// Operacao inversa: data do calendario de um momento do historico
+static SYSTEMTIME dataDoMomento(uint32_t momento) {
+    int64_t z = momento / 86400 + DIAS_ATE_2000 + 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t diaDaEra = z - era * 146097;
+    const int64_t anoDaEra = (diaDaEra - diaDaEra / 1460 + diaDaEra / 36524 - diaDaEra / 146096) / 365;
+    const int64_t diaDoAno = diaDaEra - (365 * anoDaEra + anoDaEra / 4 - anoDaEra / 100);
+    const int64_t mp = (5 * diaDoAno + 2) / 153;
+    const int mes = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+
+    SYSTEMTIME data;
+    memset(&data, 0, sizeof(data));
+    data.wYear = static_cast<WORD>(anoDaEra + era * 400 + (mes <= 2));
+    data.wMonth = static_cast<WORD>(mes);
+    data.wDay = static_cast<WORD>(diaDoAno - (153 * mp + 2) / 5 + 1);
+    data.wHour = static_cast<WORD>(momento % 86400 / 3600);
+    data.wMinute = static_cast<WORD>(momento % 3600 / 60);
+    data.wSecond = static_cast<WORD>(momento % 60);
+    return data;
+}
+
+static uint32_t diaDoSegmento(uint32_t momento) {
+    SYSTEMTIME data = dataDoMomento(momento);
+    return data.wYear * 10000u + data.wMonth * 100u + data.wDay;
+}
+
+static TipoMovimentacao tipoDoTexto(const char* tipo) {
+    if (strcmp(tipo, "SAIDA") == 0) return TIPO_SAIDA;
+    if (strcmp(tipo, "MINIMO") == 0) return TIPO_MINIMO;
+    return TIPO_ENTRADA;
+}
+
+static const char* textoDoTipo(int tipo) {
+    return tipo == TIPO_SAIDA ? "SAIDA" : tipo == TIPO_MINIMO ? "MINIMO" : "ENTRADA";
+}
+
+RegistroHistorico registroHistorico(uint32_t momento, int idProduto, int quantidade, const char* tipo) {
+    RegistroHistorico registro;
+    memset(&registro, 0, sizeof(registro));
+    registro.momento = momento;
+    registro.idProduto = idProduto;
+    registro.tipo = static_cast<uint8_t>(tipoDoTexto(tipo));
+    registro.delta = registro.tipo == TIPO_SAIDA ? -quantidade : quantidade;
+    return registro;
+}
+
+// Posicoes do ID no filtro de Bloom (hash duplo: h1 + i * h2)
+static void posicoesNoFiltro(int idProduto, uint32_t posicoes[HASHES_FILTRO_HISTORICO]) {
+    uint32_t h1 = static_cast<uint32_t>(idProduto) * 0x9E3779B1u;
+    uint32_t h2 = (static_cast<uint32_t>(idProduto) ^ 0x85EBCA6Bu) * 0xC2B2AE35u;
+    h1 ^= h1 >> 15;
+    h2 = (h2 ^ (h2 >> 13)) | 1;
+    for (int i = 0; i < HASHES_FILTRO_HISTORICO; i++) {
+        posicoes[i] = (h1 + i * h2) % BITS_FILTRO_HISTORICO;
+    }
+}
+
+static void adicionarAoFiltro(EntradaIndiceHistorico& entrada, int idProduto) {
+    uint32_t posicoes[HASHES_FILTRO_HISTORICO];
+    posicoesNoFiltro(idProduto, posicoes);
+    for (uint32_t pos : posicoes) {
+        entrada.filtro[pos / 64] |= 1ull << (pos % 64);
+    }
+}
+
+// false: o segmento certamente nao tem o produto. true: talvez tenha.
+static bool filtroPodeConter(const EntradaIndiceHistorico& entrada, int idProduto) {
+    uint32_t posicoes[HASHES_FILTRO_HISTORICO];
+    posicoesNoFiltro(idProduto, posicoes);
+    for (uint32_t pos : posicoes) {
+        if ((entrada.filtro[pos / 64] & (1ull << (pos % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void nomeDoSegmento(uint32_t dia, char* nome, size_t tamanho) {
+    sprintf_s(nome, tamanho, "historico_%08u.hst", dia);
+}
+
+// Dias dos segmentos que este processo criou (nao existiam antes da primeira
+// gravacao). O benchmark apaga exatamente estes ao limpar. Protegido por
+// mutexArquivos, como a gravacao do historico no checkpoint.
+static std::vector<uint32_t> segmentosCriados;
+
+// Le o indice esparso inteiro (poucos KB por ano de historico)
+static bool lerIndiceHistorico(std::vector<EntradaIndiceHistorico>& entradas) {
+    entradas.clear();
+    HANDLE hIndice = CreateFileA(ARQUIVO_INDICE_HISTORICO, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hIndice == INVALID_HANDLE_VALUE) {
+        return true; // Ainda nao ha historico
+    }
+
+    CabecalhoIndiceHistorico cabecalho;
+    DWORD bytesLidos = 0;
+    bool valido = ReadFile(hIndice, &cabecalho, sizeof(cabecalho), &bytesLidos, NULL) &&
+                  bytesLidos == sizeof(cabecalho) &&
+                  memcmp(cabecalho.assinatura, ASSINATURA_HISTORICO, 4) == 0 &&
+                  cabecalho.versao == VERSAO_HISTORICO &&
+                  cabecalho.tamanhoEntrada == sizeof(EntradaIndiceHistorico);
+    if (valido && cabecalho.quantidadeSegmentos > 0) {
+        entradas.resize(cabecalho.quantidadeSegmentos);
+        DWORD esperado = cabecalho.quantidadeSegmentos * sizeof(EntradaIndiceHistorico);
+        valido = ReadFile(hIndice, entradas.data(), esperado, &bytesLidos, NULL) && bytesLidos == esperado;
+    }
+    CloseHandle(hIndice);
+
+    if (!valido) {
+        std::cerr << "ERRO: indice '" << ARQUIVO_INDICE_HISTORICO << "' invalido." << std::endl;
+        entradas.clear();
+    }
+    return valido;
+}
+
+// Acrescenta registros ao historico: agrupa por dia, atualiza o resumo de
+// cada segmento no indice e acrescenta os registros no fim do segmento. O
+// indice e gravado antes do segmento: se o programa cair no meio, o resumo
+// cobre a mais (o que so custa uma leitura), nunca a menos.
+bool gravarHistorico(std::vector<RegistroHistorico>& registros) {
+    if (registros.empty()) {
+        return true;
+    }
+
+    std::vector<EntradaIndiceHistorico> entradas;
+    if (!lerIndiceHistorico(entradas)) {
+        return false;
+    }
+
+    HANDLE hIndice = CreateFileA(ARQUIVO_INDICE_HISTORICO, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                 OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hIndice == INVALID_HANDLE_VALUE) {
+        tratarErro("abrir indice do historico");
+        return false;
+    }
+
+    // Registros do mesmo dia ficam juntos (a ordem de chegada e mantida)
+    std::stable_sort(registros.begin(), registros.end(),
+                     [](const RegistroHistorico& a, const RegistroHistorico& b) {
+                         return diaDoSegmento(a.momento) < diaDoSegmento(b.momento);
+                     });
+
+    bool sucesso = true;
+    bool sincronizar = catalogo.escritorLog.modoAtual() != DURABILIDADE_NENHUMA;
+    size_t inicio = 0;
+    while (sucesso && inicio < registros.size()) {
+        uint32_t dia = diaDoSegmento(registros[inicio].momento);
+        size_t fim = inicio;
+        while (fim < registros.size() && diaDoSegmento(registros[fim].momento) == dia) {
+            fim++;
+        }
+
+        // Resumo do segmento: existente ou novo no fim do indice
+        size_t posicao = 0;
+        while (posicao < entradas.size() && entradas[posicao].dia != dia) {
+            posicao++;
+        }
+        if (posicao == entradas.size()) {
+            EntradaIndiceHistorico nova;
+            memset(&nova, 0, sizeof(nova));
+            nova.dia = dia;
+            nova.menorMomento = UINT32_MAX;
+            entradas.push_back(nova);
+        }
+        EntradaIndiceHistorico& entrada = entradas[posicao];
+        for (size_t i = inicio; i < fim; i++) {
+            entrada.menorMomento = std::min(entrada.menorMomento, registros[i].momento);
+            entrada.maiorMomento = std::max(entrada.maiorMomento, registros[i].momento);
+            adicionarAoFiltro(entrada, registros[i].idProduto);
+        }
+        entrada.quantidadeRegistros += static_cast<uint32_t>(fim - inicio);
+
+        // SYSTEM CALL: WriteFile com OVERLAPPED - Reescreve so o cabecalho e a
+        // entrada deste segmento
+        CabecalhoIndiceHistorico cabecalho;
+        memcpy(cabecalho.assinatura, ASSINATURA_HISTORICO, 4);
+        cabecalho.versao = VERSAO_HISTORICO;
+        cabecalho.tamanhoEntrada = sizeof(EntradaIndiceHistorico);
+        cabecalho.quantidadeSegmentos = static_cast<uint32_t>(entradas.size());
+        OVERLAPPED ovCabecalho = offsetPara(0);
+        OVERLAPPED ovEntrada = offsetPara(sizeof(cabecalho) + posicao * sizeof(EntradaIndiceHistorico));
+        DWORD bytesEscritos = 0;
+        sucesso = WriteFile(hIndice, &entrada, sizeof(entrada), &bytesEscritos, &ovEntrada) &&
+                  WriteFile(hIndice, &cabecalho, sizeof(cabecalho), &bytesEscritos, &ovCabecalho) &&
+                  (!sincronizar || FlushFileBuffers(hIndice));
+
+        // SYSTEM CALL: WriteFile - Um unico acrescimo por segmento
+        char nome[64];
+        nomeDoSegmento(dia, nome, sizeof(nome));
+        HANDLE hSegmento = sucesso ? CreateFileA(nome, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                                                 FILE_ATTRIBUTE_NORMAL, NULL)
+                                   : INVALID_HANDLE_VALUE;
+        if (hSegmento == INVALID_HANDLE_VALUE) {
+            sucesso = false;
+        } else {
+            // Com OPEN_ALWAYS, ERROR_ALREADY_EXISTS diz que o segmento ja existia
+            if (GetLastError() != ERROR_ALREADY_EXISTS) {
+                segmentosCriados.push_back(dia);
+            }
+            DWORD tamanho = static_cast<DWORD>((fim - inicio) * sizeof(RegistroHistorico));
+            sucesso = WriteFile(hSegmento, &registros[inicio], tamanho, &bytesEscritos, NULL) &&
+                      bytesEscritos == tamanho && (!sincronizar || FlushFileBuffers(hSegmento));
+            CloseHandle(hSegmento);
+        }
+        inicio = fim;
+    }
+    CloseHandle(hIndice);
+
+    if (!sucesso) {
+        tratarErro("gravar historico de movimentacoes");
+    }
+    return sucesso;
+}
+
+// Consulta o historico no periodo [de, ate], opcionalmente de um produto
+// (idProduto >= 0) e de um tipo (tipo != 0). So abre os segmentos cujo
+// periodo cruza o pedido e cujo filtro de Bloom pode conter o produto.
+int consultarHistorico(uint32_t de, uint32_t ate, int idProduto, int tipo) {
+    std::vector<EntradaIndiceHistorico> entradas;
+    if (!lerIndiceHistorico(entradas)) {
+        return 1;
+    }
+    std::sort(entradas.begin(), entradas.end(),
+              [](const EntradaIndiceHistorico& a, const EntradaIndiceHistorico& b) { return a.dia < b.dia; });
+
+    size_t foraDoPeriodo = 0, foraDoFiltro = 0, lidos = 0;
+    uint64_t registrosLidos = 0, encontrados = 0;
+    long long saldoDoPeriodo = 0;
+
+    printf("%-19s | %-7s | %10s | %10s\n", "Data", "Tipo", "ID", "Quantidade");
+    for (const auto& entrada : entradas) {
+        if (entrada.maiorMomento < de || entrada.menorMomento > ate) {
+            foraDoPeriodo++;
+            continue;
+        }
+        if (idProduto >= 0 && !filtroPodeConter(entrada, idProduto)) {
+            foraDoFiltro++;
+            continue;
+        }
+
+        char nome[64];
+        nomeDoSegmento(entrada.dia, nome, sizeof(nome));
+        ArquivoMapeado segmento(nome);
+        if (!segmento.aberto()) {
+            continue;
+        }
+        lidos++;
+
+        // Um registro incompleto no fim (queda no meio da escrita) e ignorado
+        const RegistroHistorico* registros = reinterpret_cast<const RegistroHistorico*>(segmento.inicio());
+        size_t quantidade = segmento.tamanhoBytes() / sizeof(RegistroHistorico);
+        registrosLidos += quantidade;
+        for (size_t i = 0; i < quantidade; i++) {
+            const RegistroHistorico& r = registros[i];
+            if (r.momento < de || r.momento > ate || (idProduto >= 0 && r.idProduto != idProduto) ||
+                (tipo != 0 && r.tipo != tipo)) {
+                continue;
+            }
+            char dataHora[64];
+            formatarDataHora(dataDoMomento(r.momento), dataHora, sizeof(dataHora));
+            printf("%-19s | %-7s | %10d | %10d\n", dataHora, textoDoTipo(r.tipo), r.idProduto, r.delta);
+            encontrados++;
+            if (r.tipo != TIPO_MINIMO) {
+                saldoDoPeriodo += r.delta;
+            }
+        }
+    }
+
+    printf("\nRegistros encontrados: %llu (variacao do estoque no periodo: %lld)\n",
+           (unsigned long long)encontrados, saldoDoPeriodo);
+    printf("Segmentos: %zu | fora do periodo: %zu | descartados pelo filtro: %zu | lidos: %zu (%llu registros)\n",
+           entradas.size(), foraDoPeriodo, foraDoFiltro, lidos, (unsigned long long)registrosLidos);
+    fflush(stdout);
+    return 0;
+}
+
+// Converte o log legado em texto ("Tipo: SAIDA | ID: 3 | Nome: ... | Qtd: 5 |
+// Data: [atual]") para o historico binario. O formato antigo nao tinha data:
+// todos os registros recebem a data de modificacao do arquivo.
+int converterHistoricoLegado(const char* arquivoLegado) {
+    std::cout << "=== CONVERSAO DO HISTORICO LEGADO ===\n";
+
+    WIN32_FILE_ATTRIBUTE_DATA atributos;
+    ArquivoMapeado legado(arquivoLegado);
+    if (!legado.aberto() || !GetFileAttributesExA(arquivoLegado, GetFileExInfoStandard, &atributos)) {
+        tratarErro("abrir historico legado");
+        return 1;
+    }
+
+    // SYSTEM CALL: FileTimeToLocalFileTime/FileTimeToSystemTime - Data de
+    // modificacao do arquivo na hora local
+    FILETIME local;
+    SYSTEMTIME modificadoEm;
+    FileTimeToLocalFileTime(&atributos.ftLastWriteTime, &local);
+    FileTimeToSystemTime(&local, &modificadoEm);
+    uint32_t momento = momentoHistorico(modificadoEm);
+
+    std::vector<RegistroHistorico> registros;
+    size_t ignoradas = 0;
+    percorrerLinhasMapeadas(legado, [&](const char* inicio, const char* fim, size_t) {
+        std::string linha(inicio, fim);
+        char tipo[16];
+        int id, quantidade;
+        const char* campoQtd = strstr(linha.c_str(), "| Qtd: ");
+        if (sscanf_s(linha.c_str(), "Tipo: %15s | ID: %d", tipo, (int)sizeof(tipo), &id) == 2 &&
+            campoQtd != NULL && sscanf_s(campoQtd, "| Qtd: %d", &quantidade) == 1) {
+            registros.push_back(registroHistorico(momento, id, quantidade, tipo));
+        } else if (!linha.empty()) {
+            ignoradas++;
+        }
+    });
+
+    if (!gravarHistorico(registros)) {
+        return 1;
+    }
+    char dataHora[64];
+    formatarDataHora(modificadoEm, dataHora, sizeof(dataHora));
+    std::cout << registros.size() << " movimentacao(oes) convertida(s) com data " << dataHora;
+    if (ignoradas > 0) {
+        std::cout << " (" << ignoradas << " linha(s) ignorada(s))";
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+// Le "AAAA-MM-DD" ou "AAAA-MM-DD HH:MM:SS" (tambem com 'T' no lugar do
+// espaco). So a data: inicio do dia em 'de' e fim do dia em 'ate'.
+static bool lerMomentoDoTexto(const char* texto, bool fimDoDia, uint32_t& momento) {
+    int ano, mes, dia, hora = 0, minuto = 0, segundo = 0;
+    char separador;
+    int lidos = sscanf_s(texto, "%d-%d-%d%c%d:%d:%d", &ano, &mes, &dia, &separador, 1, &hora, &minuto, &segundo);
+    if (lidos < 3 || mes < 1 || mes > 12 || dia < 1 || dia > 31) {
+        return false;
+    }
+    if (lidos < 7) {
+        hora = fimDoDia ? 23 : 0;
+        minuto = segundo = fimDoDia ? 59 : 0;
+    }
+    SYSTEMTIME data;
+    memset(&data, 0, sizeof(data));
+    data.wYear = (WORD)ano; data.wMonth = (WORD)mes; data.wDay = (WORD)dia;
+    data.wHour = (WORD)hora; data.wMinute = (WORD)minuto; data.wSecond = (WORD)segundo;
+    momento = momentoHistorico(data);
+    return true;
+}
+
+// --historico [--de DATA] [--ate DATA] [--produto ID] [--tipo ENTRADA|SAIDA|MINIMO]
+int executarConsultaHistorico(int argc, char* argv[]) {
+    // As movimentacoes ainda no log entram no historico antes da consulta
+    garantirCatalogoAtualizado();
+    if (!catalogo.historicoPendente.empty()) {
+        std::unique_lock<std::shared_mutex> trava(catalogo.mutexCatalogo);
+        realizarCheckpoint();
+    }
+
+    uint32_t de = 0, ate = UINT32_MAX;
+    int idProduto = -1, tipo = 0;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        bool valido = true;
+        if (strcmp(argv[i], "--de") == 0) {
+            valido = lerMomentoDoTexto(argv[i + 1], false, de);
+        } else if (strcmp(argv[i], "--ate") == 0) {
+            valido = lerMomentoDoTexto(argv[i + 1], true, ate);
+        } else if (strcmp(argv[i], "--produto") == 0) {
+            idProduto = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--tipo") == 0) {
+            tipo = tipoDoTexto(argv[i + 1]);
+            valido = strcmp(textoDoTipo(tipo), argv[i + 1]) == 0;
+        } else {
+            valido = false;
+        }
+        if (!valido) {
+            std::cerr << "Opcao invalida: " << argv[i] << " " << argv[i + 1] << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "=== HISTORICO DE MOVIMENTACOES ===\n";
+    return consultarHistorico(de, ate, idProduto, tipo);
+}
+
+// === MODO LOTE ===
+// Interpreta uma linha de movimentacao "ENTRADA|id|quantidade" ou
+// "SAIDA|id|quantidade" (quantidade > 0)
+static bool interpretarLinhaMovimentacao(const char* inicio, const char* fim, bool& entrada, int& id, int& quantidade) {
+    const char* sep1 = static_cast<const char*>(memchr(inicio, '|', fim - inicio));
+    if (sep1 == NULL) return false;
+    const char* sep2 = static_cast<const char*>(memchr(sep1 + 1, '|', fim - sep1 - 1));
+    if (sep2 == NULL) return false;
+
+    std::string_view tipo(inicio, sep1 - inicio);
+    if (tipo == "ENTRADA") {
+        entrada = true;
+    } else if (tipo == "SAIDA") {
+        entrada = false;
+    } else {
+        return false;
+    }
+    return lerCampoInteiro(sep1 + 1, sep2, id) && lerCampoInteiro(sep2 + 1, fim, quantidade) && quantidade > 0;
+}
+
+// Aplica um arquivo de movimentacoes inteiro em uma unica passada sobre o
+// catalogo em memoria. As movimentacoes validas vao para o log em blocos
+// grandes; as invalidas (formato, produto inexistente, saldo insuficiente
+// ou que passaria do limite do int32) vao para o arquivo de rejeitados com
+// o motivo. O estoque e gravado uma unica vez, no checkpoint do final.
+int processarLoteDeMovimentacoes(const char* arquivoMovimentos, const char* arquivoRejeitados, bool exibirResumo) {
+    if (exibirResumo) {
+        std::cout << "=== PROCESSAMENTO EM LOTE ===\n";
+    }
+
+    LARGE_INTEGER frequencia, inicio, fim;
+    QueryPerformanceFrequency(&frequencia);
+    QueryPerformanceCounter(&inicio);
+
+    garantirCatalogoAtualizado();
+
+    ArquivoMapeado movimentos(arquivoMovimentos);
+    if (!movimentos.aberto()) {
+        tratarErro("abrir arquivo de movimentacoes do lote");
+        return 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+        catalogo.escritorLog.fechar();
+    }
+    HANDLE hLog = CreateFileA(ARQUIVO_LOG_MOVIMENTACOES, FILE_APPEND_DATA, FILE_SHARE_READ, NULL,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    HANDLE hRejeitados = CreateFileA(arquivoRejeitados, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                     CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hLog == INVALID_HANDLE_VALUE || hRejeitados == INVALID_HANDLE_VALUE) {
+        tratarErro("abrir arquivos de saida do lote");
+        if (hLog != INVALID_HANDLE_VALUE) CloseHandle(hLog);
+        if (hRejeitados != INVALID_HANDLE_VALUE) CloseHandle(hRejeitados);
+        return 1;
+    }
+
+    // Todas as movimentacoes do lote levam a mesma data/hora
+    SYSTEMTIME agora;
+    GetLocalTime(&agora);
+    char dataHora[64];
+    formatarDataHora(agora, dataHora, sizeof(dataHora));
+    uint32_t momento = momentoHistorico(agora);
+
+    size_t aplicadas = 0;
+    size_t rejeitadas = 0;
+    {
+        BufferDeEscrita log(hLog);
+        BufferDeEscrita rejeitados(hRejeitados);
+
+        percorrerLinhasMapeadas(movimentos, [&](const char* inicioLinha, const char* fimLinha, size_t numeroLinha) {
+            bool entrada;
+            int id, quantidade;
+            const char* motivo = NULL;
+            int slot = -1;
 
-    // SYSTEM CALL: CreateFile - Abre o arquivo para leitura
-    HANDLE hArquivo = CreateFileA(
-        ARQUIVO_ESTOQUE,
-        GENERIC_READ,
-        FILE_SHARE_READ,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
+            if (!interpretarLinhaMovimentacao(inicioLinha, fimLinha, entrada, id, quantidade)) {
+                motivo = "linha mal formada";
+            } else if ((slot = buscarSlotPorId(id)) < 0) {
+                motivo = "produto nao encontrado";
+            } else if (!entrada && catalogo.produtos.quantidades[slot] < quantidade) {
+                motivo = "quantidade insuficiente em estoque";
+            } else if (entrada && quantidade > INT32_MAX - catalogo.produtos.quantidades[slot]) {
+                motivo = "saldo ultrapassaria o limite do estoque";
+            }
 
-    if (hArquivo == INVALID_HANDLE_VALUE) {
-        std::cout << "Arquivo de estoque nao encontrado ou vazio." << std::endl;
-        return;
+            char linha[MAX_NOME + 80];
+            int tamanho;
+            if (motivo != NULL) {
+                tamanho = sprintf_s(linha, sizeof(linha), "%zu|%.*s|%s\n", numeroLinha,
+                                    static_cast<int>(std::min<ptrdiff_t>(fimLinha - inicioLinha, 60)), inicioLinha, motivo);
+                rejeitados.acrescentar(linha, tamanho);
+                rejeitadas++;
+                return;
+            }
+
+            int32_t& saldo = catalogo.produtos.quantidades[slot];
+            contabilizarProduto(slot, -1);
+            saldo += entrada ? quantidade : -quantidade;
+            contabilizarProduto(slot, +1);
+            tamanho = sprintf_s(linha, sizeof(linha), "%llu|%s|%d|%d|%d|%s\n",
+                                catalogo.proximaSequencia++, entrada ? "ENTRADA" : "SAIDA",
+                                id, quantidade, saldo, dataHora);
+            log.acrescentar(linha, tamanho);
+            catalogo.historicoPendente.push_back(
+                registroHistorico(momento, id, quantidade, entrada ? "ENTRADA" : "SAIDA"));
+            aplicadas++;
+        });
+
+        if (!log.descarregar() || !rejeitados.descarregar()) {
+            tratarErro("gravar arquivos do lote");
+        }
+    }
+    // O lote inteiro e um unico grupo: um so flush no fim. Se ele falhar as
+    // movimentacoes continuam aplicadas (o checkpoint abaixo ainda grava o
+    // estoque), mas o lote nao e dado como confirmado
+    bool confirmado = true;
+    if (catalogo.escritorLog.modoAtual() != DURABILIDADE_NENHUMA && !FlushFileBuffers(hLog)) {
+        tratarErro("sincronizar log do lote");
+        confirmado = false;
+    }
+    CloseHandle(hLog);
+    CloseHandle(hRejeitados);
+    catalogo.movimentacoesPendentes += static_cast<int>(aplicadas);
+    {
+        std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+        catalogo.assinaturaLog = obterAssinaturaArquivo(ARQUIVO_LOG_MOVIMENTACOES);
+        catalogo.bytesLogProprios = 0;
     }
 
-    // Obter o tamanho do arquivo para alocar o buffer de leitura
-    DWORD tamanhoArquivo = GetFileSize(hArquivo, NULL);
-    if (tamanhoArquivo == 0) {
-        std::cout << "Estoque vazio." << std::endl;
-        CloseHandle(hArquivo);
-        return;
+    // Grava o estoque uma unica vez: no formato binario o arquivo e reescrito
+    // sequencialmente (mais barato que uma escrita posicionada por produto)
+    bool salvo;
+    if (catalogo.usaBinario) {
+        fecharArquivoBinario();
+        salvo = salvarProdutosNoArquivoBinario(catalogo.produtos) && abrirArquivoBinario();
+        if (salvo) {
+            catalogo.registrosBinariosAtrasados = false;
+        }
+        catalogo.assinatura = obterAssinaturaArquivo(ARQUIVO_ESTOQUE_BINARIO);
+    } else {
+        salvo = true;
     }
+    salvo = salvo && realizarCheckpoint();
 
-    char* buffer = new char[tamanhoArquivo + 1];
-    DWORD bytesLidos;
-
-    // SYSTEM CALL: ReadFile - Le o conteudo do arquivo para o buffer
-    BOOL sucesso = ReadFile(
-        hArquivo,
-        buffer,
-        tamanhoArquivo,
-        &bytesLidos,
-        NULL
-    );
+    salvo = salvo && confirmado;
 
-    // SYSTEM CALL: CloseHandle - Fecha o arquivo
-    CloseHandle(hArquivo);
+    QueryPerformanceCounter(&fim);
+    double segundos = static_cast<double>(fim.QuadPart - inicio.QuadPart) / frequencia.QuadPart;
+    size_t total = aplicadas + rejeitadas;
+    if (!exibirResumo) {
+        return salvo ? 0 : 1;
+    }
 
-    if (!sucesso) {
-        tratarErro("ler arquivo");
-        delete[] buffer;
-        return;
+    printf("Linhas processadas:     %zu\n", total);
+    printf("Movimentacoes aplicadas: %zu%s\n", aplicadas, confirmado ? "" : " (nao confirmadas no disco)");
+    printf("Movimentacoes rejeitadas: %zu (detalhes em '%s')\n", rejeitadas, arquivoRejeitados);
+    printf("Tempo total:            %.3f s\n", segundos);
+    if (segundos > 0) {
+        printf("Vazao:                  %.0f movimentacoes/s | %.1f MB/s\n",
+               total / segundos, movimentos.tamanhoBytes() / (1024.0 * 1024.0) / segundos);
     }
+    return salvo ? 0 : 1;
+}
 
-    buffer[bytesLidos] = '\0'; // Termina a string
-    
-    // Exibe o cabecalho
-    printf("ID\t| Nome\t\t\t\t| Quantidade\t| Preco (R$)\n");
-    printf("--------------------------------------------------------------------------------\n");
+// === MODO BENCHMARK ===
+// Mede as operacoes do estoque sobre catalogos sinteticos, sem passar pelo
+// menu: cada tamanho e gerado do zero em um diretorio de trabalho proprio
+// (os arquivos reais do estoque nao sao tocados). Cada operacao roda algumas
+// vezes de aquecimento (descartadas) e depois as repeticoes medidas.
+//   ControleEstoque --benchmark [--tamanhos 10000,1000000,10000000]
+//       [--nome-min N] [--nome-max N] [--nome-dist uniforme|normal]
+//       [--aquecimento N] [--repeticoes N] [--operacoes N] [--lote N]
+//       [--csv arquivo] [--json arquivo] [--diretorio DIR]
+struct ConfiguracaoBenchmark {
+    std::vector<size_t> tamanhos;
+    int nomeMinimo;
+    int nomeMaximo;
+    bool nomeNormal;         // Comprimentos em curva normal em vez de uniforme
+    int aquecimento;         // Rodadas descartadas antes das medidas
+    int repeticoes;          // Rodadas medidas
+    int operacoesPorRodada;  // Movimentacoes/buscas avulsas por rodada
+    int movimentosNoLote;
+    std::string arquivoCsv;
+    std::string arquivoJson;
+    std::string diretorio;
+};
 
-    // Processa o buffer lido linha por linha
-    char* linha = strtok(buffer, "\n");
-    int contador = 0;
-    while (linha != NULL) {
-        if (strlen(linha) > 0) {
-            Produto p;
-            sscanf_s(linha, "%d|%99[^|]|%d|%lf", &p.id, p.nome, (int)sizeof(p.nome), &p.quantidade, &p.preco);
+// Estatisticas de uma operacao em um tamanho de catalogo (tempos em us)
+struct ResultadoBenchmark {
+    size_t produtos;
+    const char* operacao;
+    size_t amostras;
+    size_t itensPorAmostra; // Produtos/movimentacoes tratados por amostra
+    double minimo;
+    double p50;
+    double p99;
+    double maximo;
+    double media;
+};
 
-            printf("%d\t| %-25s\t| %-10d\t| %.2f\n",
-                   p.id, p.nome, p.quantidade, p.preco);
-            contador++;
-        }
-        linha = strtok(NULL, "\n");
+// Nomes sinteticos montados com palavras de mercearia, para que a busca por
+// trecho encontre quantidades realistas de produtos
+static const char* const PALAVRAS_BENCHMARK[] = {
+    "Arroz", "Feijao", "Cafe", "Acucar", "Oleo", "Sabao", "Leite", "Farinha", "Macarrao", "Biscoito",
+    "Molho", "Tomate", "Integral", "Branco", "Preto", "Torrado", "Refinado", "Cristal", "Parafuso",
+    "Chocolate", "Morango", "Baunilha", "Pacote", "Caixa", "Grande", "Pequeno", "Light", "Premium"};
+static const char* const TERMOS_BENCHMARK[] = {
+    "arroz", "feij", "cafe torr", "acuca", "leite integral", "macarrao parafuso", "choc", "premium",
+    "molho de tomate", "biscoito morango", "xyz"};
+
+// Amostras de tempo em microssegundos
+static double microssegundosDesde(const LARGE_INTEGER& inicio) {
+    LARGE_INTEGER agora, frequencia;
+    QueryPerformanceCounter(&agora);
+    QueryPerformanceFrequency(&frequencia);
+    return (agora.QuadPart - inicio.QuadPart) * 1000000.0 / frequencia.QuadPart;
+}
+
+static ResultadoBenchmark resumirAmostras(size_t produtos, const char* operacao, size_t itensPorAmostra,
+                                          std::vector<double>& amostras) {
+    ResultadoBenchmark r = {produtos, operacao, amostras.size(), itensPorAmostra, 0, 0, 0, 0, 0};
+    if (amostras.empty()) {
+        return r;
     }
+    std::sort(amostras.begin(), amostras.end());
+    // Percentil pelo posto mais proximo
+    auto percentil = [&amostras](double fracao) {
+        size_t posto = static_cast<size_t>(std::ceil(fracao * amostras.size()));
+        return amostras[std::min(amostras.size(), std::max<size_t>(1, posto)) - 1];
+    };
+    r.minimo = amostras.front();
+    r.maximo = amostras.back();
+    r.p50 = percentil(0.50);
+    r.p99 = percentil(0.99);
+    double soma = 0;
+    for (double a : amostras) {
+        soma += a;
+    }
+    r.media = soma / amostras.size();
+    return r;
+}
 
-    std::cout << "\nTotal de produtos: " << contador << std::endl;
-    delete[] buffer;
+// Silencia o std::cout das operacoes medidas (menus e confirmacoes); avisos
+// e erros continuam saindo no std::cerr
+class SaidaSilenciada {
+public:
+    SaidaSilenciada() : anterior(std::cout.rdbuf(&descarte)) {}
+    ~SaidaSilenciada() { std::cout.rdbuf(anterior); }
+
+private:
+    struct Descarte : std::streambuf {
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    } descarte;
+    std::streambuf* anterior;
+};
+
+// Grava um texto inteiro em um arquivo (resultados CSV/JSON)
+static bool gravarTextoNoArquivo(const char* nomeArquivo, const std::string& texto) {
+    HANDLE hArquivo = CreateFileA(nomeArquivo, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        tratarErro("criar arquivo de resultados do benchmark");
+        return false;
+    }
+    DWORD bytesEscritos = 0;
+    BOOL sucesso = WriteFile(hArquivo, texto.data(), (DWORD)texto.size(), &bytesEscritos, NULL) &&
+                   bytesEscritos == texto.size();
+    CloseHandle(hArquivo);
+    return sucesso != FALSE;
 }
 
-// 3. SYSTEM CALLS: Leitura e filtragem - Busca de produto
-void buscarProduto() {
-    std::cout << "\n=== BUSCAR PRODUTO ===\n";
-    std::cout << "Digite o nome (ou parte dele): ";
-    std::string termoBusca;
-    std::getline(std::cin, termoBusca);
+// Apaga os arquivos de estoque, log, historico e relatorio do diretorio de
+// trabalho, depois de fechar os que o catalogo mantem abertos. Do historico
+// so saem os segmentos que a execucao criou (todos eles, mesmo que ela
+// tenha passado da meia-noite).
+static void limparArquivosDoBenchmark() {
+    fecharArquivoBinario();
+    std::lock_guard<std::mutex> trava(catalogo.mutexArquivos);
+    catalogo.escritorLog.fechar();
 
-    // A maneira mais simples de buscar e ler todo o arquivo
-    // para a memoria, e entao filtrar
-    std::vector<Produto> produtos = lerProdutosDoArquivo();
+    const char* arquivos[] = {ARQUIVO_ESTOQUE, ARQUIVO_ESTOQUE_TEMP, ARQUIVO_ESTOQUE_BINARIO,
+                              ARQUIVO_ESTOQUE_BINARIO_TEMP, ARQUIVO_LOG_MOVIMENTACOES, ARQUIVO_RELATORIO,
+                              ARQUIVO_INDICE_HISTORICO};
+    for (const char* arquivo : arquivos) {
+        // SYSTEM CALL: DeleteFile - Remove o arquivo (ausente nao e erro aqui)
+        DeleteFileA(arquivo);
+    }
+    for (uint32_t dia : segmentosCriados) {
+        char segmento[64];
+        nomeDoSegmento(dia, segmento, sizeof(segmento));
+        DeleteFileA(segmento);
+    }
+    segmentosCriados.clear();
+    catalogo.carregado = false;
+}
 
-    if (produtos.empty()) {
-        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
-        return;
+// Gera o estoque.txt sintetico com n produtos (IDs 1..n)
+static bool gerarCatalogoSintetico(size_t n, const ConfiguracaoBenchmark& config, std::mt19937& gerador) {
+    HANDLE hArquivo = CreateFileA(ARQUIVO_ESTOQUE, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        tratarErro("criar catalogo sintetico");
+        return false;
     }
 
-    std::cout << "\nResultados da busca:\n";
-    std::cout << "----------------------------------------------------------------\n";
+    const size_t numPalavras = sizeof(PALAVRAS_BENCHMARK) / sizeof(PALAVRAS_BENCHMARK[0]);
+    std::uniform_int_distribution<int> uniforme(config.nomeMinimo, config.nomeMaximo);
+    std::normal_distribution<double> normal((config.nomeMinimo + config.nomeMaximo) / 2.0,
+                                            std::max(1.0, (config.nomeMaximo - config.nomeMinimo) / 6.0));
+    std::uniform_int_distribution<int> quantidade(0, 200);
+    std::uniform_int_distribution<int> precoCentavos(50, 99999);
 
-    int encontrados = 0;
-    for (const auto& p : produtos) {
-        std::string nomeProduto = p.nome;
-        // CORRECAO: Uso de std::transform e std::tolower apos inclusao dos cabecalhos
-        std::transform(nomeProduto.begin(), nomeProduto.end(), nomeProduto.begin(),
-                       [](unsigned char c){ return std::tolower(c); });
-        std::string buscaLower = termoBusca;
-        std::transform(buscaLower.begin(), buscaLower.end(), buscaLower.begin(),
-                       [](unsigned char c){ return std::tolower(c); });
-
-        if (nomeProduto.find(buscaLower) != std::string::npos) {
-            printf("ID: %d | Nome: %s | Quantidade: %d | Preco: %.2f\n",
-                   p.id, p.nome, p.quantidade, p.preco);
-            encontrados++;
+    BufferDeEscrita saida(hArquivo);
+    std::string nome;
+    char linha[MAX_NOME + 50];
+    for (size_t i = 1; i <= n; i++) {
+        int comprimento = config.nomeNormal ? static_cast<int>(std::lround(normal(gerador))) : uniforme(gerador);
+        comprimento = std::max(config.nomeMinimo, std::min(config.nomeMaximo, comprimento));
+
+        // Palavras ate passar do comprimento sorteado, depois corta; o final
+        // com o ID deixa os nomes distintos
+        char sufixo[16];
+        int tamanhoSufixo = sprintf_s(sufixo, sizeof(sufixo), " %zu", i);
+        nome.clear();
+        while (static_cast<int>(nome.size()) + tamanhoSufixo < comprimento) {
+            if (!nome.empty()) {
+                nome += ' ';
+            }
+            nome += PALAVRAS_BENCHMARK[gerador() % numPalavras];
         }
+        nome.resize(std::max(0, comprimento - tamanhoSufixo));
+        nome += sufixo;
+
+        int preco = precoCentavos(gerador);
+        int tamanho = sprintf_s(linha, sizeof(linha), "%zu|%s|%d|%d.%02d\n", i, nome.c_str(), quantidade(gerador),
+                                preco / 100, preco % 100);
+        saida.acrescentar(linha, tamanho);
     }
+    bool gravado = saida.descarregar();
+    CloseHandle(hArquivo);
+    return gravado;
+}
 
-    if (encontrados == 0) {
-        std::cout << "Nenhum produto encontrado com esse nome." << std::endl;
-    } else {
-        std::cout << "\n" << encontrados << " produto(s) encontrado(s)." << std::endl;
+// Arquivo de lote com pares ENTRADA/SAIDA de 1 unidade (o saldo nao muda,
+// entao o mesmo arquivo pode ser aplicado em todas as rodadas)
+static bool gerarLoteSintetico(const char* nomeArquivo, size_t produtos, int movimentos, std::mt19937& gerador) {
+    HANDLE hArquivo = CreateFileA(nomeArquivo, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hArquivo == INVALID_HANDLE_VALUE) {
+        tratarErro("criar lote sintetico");
+        return false;
+    }
+    std::uniform_int_distribution<size_t> id(1, produtos);
+    BufferDeEscrita saida(hArquivo);
+    char linha[64];
+    for (int i = 0; i + 1 < movimentos; i += 2) {
+        size_t escolhido = id(gerador);
+        saida.acrescentar(linha, sprintf_s(linha, sizeof(linha), "ENTRADA|%zu|1\nSAIDA|%zu|1\n", escolhido, escolhido));
     }
+    bool gravado = saida.descarregar();
+    CloseHandle(hArquivo);
+    return gravado;
 }
 
-// 4. SYSTEM CALLS: Leitura, modificacao e escrita - Saida de mercadoria
-void darSaidaEmProduto() {
-    std::cout << "\n=== SAIDA DE MERCADORIA ===\n";
-    std::cout << "Digite o ID do produto: ";
-    int idProduto;
-    std::cin >> idProduto;
-    std::cout << "Digite a quantidade a ser retirada: ";
-    int quantidadeRetirada;
-    std::cin >> quantidadeRetirada;
+// Roda 'operacao' (que devolve suas proprias amostras) nas rodadas de
+// aquecimento e nas medidas, guardando so as medidas
+template <typename Operacao>
+static ResultadoBenchmark medirOperacao(const ConfiguracaoBenchmark& config, size_t produtos, const char* nome,
+                                        size_t itensPorAmostra, Operacao operacao) {
+    std::vector<double> amostras;
+    for (int rodada = 0; rodada < config.aquecimento + config.repeticoes; rodada++) {
+        std::vector<double> daRodada;
+        operacao(daRodada);
+        if (rodada >= config.aquecimento) {
+            amostras.insert(amostras.end(), daRodada.begin(), daRodada.end());
+        }
+    }
+    ResultadoBenchmark r = resumirAmostras(produtos, nome, itensPorAmostra, amostras);
+    printf("%10zu  %-14s %8zu %12.1f %12.1f %12.1f %12.1f\n", r.produtos, r.operacao, r.amostras, r.p50, r.p99,
+           r.maximo, r.media);
+    fflush(stdout);
+    return r;
+}
 
-    std::vector<Produto> produtos = lerProdutosDoArquivo();
-    if (produtos.empty()) {
-        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
+// Mede todas as operacoes sobre um catalogo sintetico de n produtos
+static void executarBenchmarkTamanho(size_t n, const ConfiguracaoBenchmark& config,
+                                     std::vector<ResultadoBenchmark>& resultados) {
+    std::mt19937 gerador(static_cast<uint32_t>(n)); // Mesmo catalogo a cada execucao
+    const char* ARQUIVO_LOTE = "benchmark_lote.txt";
+    const char* ARQUIVO_LOTE_REJEITADOS = "benchmark_lote.rejeitados";
+
+    limparArquivosDoBenchmark();
+    LARGE_INTEGER inicio;
+    QueryPerformanceCounter(&inicio);
+    if (!gerarCatalogoSintetico(n, config, gerador) ||
+        !gerarLoteSintetico(ARQUIVO_LOTE, n, config.movimentosNoLote, gerador)) {
         return;
     }
+    std::vector<double> geracao(1, microssegundosDesde(inicio));
+    resultados.push_back(resumirAmostras(n, "geracao", n, geracao));
+    printf("%10zu  %-14s %8d %12.1f\n", n, "geracao", 1, geracao[0]);
 
-    bool encontrou = false;
-    for (auto& p : produtos) {
-        if (p.id == idProduto) {
-            encontrou = true;
-            if (p.quantidade >= quantidadeRetirada) {
-                p.quantidade -= quantidadeRetirada;
-                std::cout << "? Retirada de " << quantidadeRetirada << " unidades de '" << p.nome << "' realizada com sucesso!" << std::endl;
-                registrarMovimentacao(p, quantidadeRetirada, "SAIDA");
-                // Salva a lista de produtos atualizada de volta no arquivo
-                salvarProdutosNoArquivo(produtos);
-            } else {
-                std::cout << "? Erro: Quantidade insuficiente em estoque. Disponivel: " << p.quantidade << std::endl;
+    // Carga completa: leitura do texto, indice por ID, log e agregados
+    resultados.push_back(medirOperacao(config, n, "carga", n, [](std::vector<double>& amostras) {
+        catalogo.carregado = false;
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        garantirCatalogoAtualizado();
+        amostras.push_back(microssegundosDesde(t));
+    }));
+
+    resultados.push_back(medirOperacao(config, n, "indice_busca", n, [](std::vector<double>& amostras) {
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        catalogo.trigramas.construir(catalogo.produtos);
+        amostras.push_back(microssegundosDesde(t));
+    }));
+
+    const size_t numTermos = sizeof(TERMOS_BENCHMARK) / sizeof(TERMOS_BENCHMARK[0]);
+    resultados.push_back(medirOperacao(config, n, "busca", 1, [&](std::vector<double>& amostras) {
+        for (int i = 0; i < config.operacoesPorRodada; i++) {
+            LARGE_INTEGER t;
+            QueryPerformanceCounter(&t);
+            size_t encontrados = 0;
+            catalogo.trigramas.buscar(normalizarNome(TERMOS_BENCHMARK[i % numTermos]), 20, encontrados);
+            amostras.push_back(microssegundosDesde(t));
+        }
+    }));
+
+    // Movimentacao avulsa, como no menu e no servidor (inclui o checkpoint
+    // quando o log chega ao limite). ENTRADA e SAIDA se alternam no mesmo
+    // produto para o saldo nao mudar.
+    std::uniform_int_distribution<int> id(1, static_cast<int>(n));
+    resultados.push_back(medirOperacao(config, n, "movimentacao", 1, [&](std::vector<double>& amostras) {
+        int escolhido = 1;
+        for (int i = 0; i < config.operacoesPorRodada; i++) {
+            if (i % 2 == 0) {
+                escolhido = id(gerador);
             }
-            break;
+            LARGE_INTEGER t;
+            QueryPerformanceCounter(&t);
+            aplicarMovimentacao(escolhido, 1, i % 2 == 0, NULL);
+            realizarCheckpointSeNecessario();
+            amostras.push_back(microssegundosDesde(t));
         }
-    }
+    }));
 
-    if (!encontrou) {
-        std::cout << "? Produto nao encontrado!" << std::endl;
-    }
+    resultados.push_back(medirOperacao(config, n, "lote", config.movimentosNoLote,
+                                       [&](std::vector<double>& amostras) {
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        processarLoteDeMovimentacoes(ARQUIVO_LOTE, ARQUIVO_LOTE_REJEITADOS, false);
+        amostras.push_back(microssegundosDesde(t));
+    }));
+
+    resultados.push_back(medirOperacao(config, n, "relatorio", n, [](std::vector<double>& amostras) {
+        SaidaSilenciada silencio;
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        gerarRelatorio();
+        amostras.push_back(microssegundosDesde(t));
+    }));
+
+    resultados.push_back(medirOperacao(config, n, "salvar", n, [](std::vector<double>& amostras) {
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        salvarProdutosNoArquivo(catalogo.produtos);
+        amostras.push_back(microssegundosDesde(t));
+    }));
+
+    limparArquivosDoBenchmark();
+    DeleteFileA(ARQUIVO_LOTE);
+    DeleteFileA(ARQUIVO_LOTE_REJEITADOS);
 }
 
-// 5. SYSTEM CALLS: Leitura, modificacao e escrita - Entrada de mercadoria
-void darEntradaEmProduto() {
-    std::cout << "\n=== ENTRADA DE MERCADORIA ===\n";
-    std::cout << "Digite o ID do produto: ";
-    int idProduto;
-    std::cin >> idProduto;
-    std::cout << "Digite a quantidade a ser adicionada: ";
-    int quantidadeAdicionada;
-    std::cin >> quantidadeAdicionada;
+static std::string resultadosEmCsv(const std::vector<ResultadoBenchmark>& resultados) {
+    std::string csv = "produtos,operacao,amostras,itens_por_amostra,min_us,p50_us,p99_us,max_us,media_us\n";
+    char linha[256];
+    for (const auto& r : resultados) {
+        sprintf_s(linha, sizeof(linha), "%zu,%s,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f\n", r.produtos, r.operacao,
+                  r.amostras, r.itensPorAmostra, r.minimo, r.p50, r.p99, r.maximo, r.media);
+        csv += linha;
+    }
+    return csv;
+}
 
-    std::vector<Produto> produtos = lerProdutosDoArquivo();
-    if (produtos.empty()) {
-        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
-        return;
+static std::string resultadosEmJson(const std::vector<ResultadoBenchmark>& resultados,
+                                    const ConfiguracaoBenchmark& config) {
+    char linha[512];
+    sprintf_s(linha, sizeof(linha),
+              "{\n  \"kernel\": \"%s\",\n  \"durabilidade\": \"%s\",\n  \"nome_min\": %d,\n  \"nome_max\": %d,\n"
+              "  \"nome_dist\": \"%s\",\n  \"aquecimento\": %d,\n  \"repeticoes\": %d,\n  \"resultados\": [\n",
+              kernelsEstoque().nome, nomeDoModo(catalogo.escritorLog.modoAtual()), config.nomeMinimo,
+              config.nomeMaximo, config.nomeNormal ? "normal" : "uniforme", config.aquecimento, config.repeticoes);
+    std::string json = linha;
+    for (size_t i = 0; i < resultados.size(); i++) {
+        const ResultadoBenchmark& r = resultados[i];
+        sprintf_s(linha, sizeof(linha),
+                  "    {\"produtos\": %zu, \"operacao\": \"%s\", \"amostras\": %zu, \"itens_por_amostra\": %zu, "
+                  "\"min_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, \"media_us\": %.3f}%s\n",
+                  r.produtos, r.operacao, r.amostras, r.itensPorAmostra, r.minimo, r.p50, r.p99, r.maximo, r.media,
+                  i + 1 < resultados.size() ? "," : "");
+        json += linha;
     }
+    json += "  ]\n}\n";
+    return json;
+}
 
-    bool encontrou = false;
-    for (auto& p : produtos) {
-        if (p.id == idProduto) {
-            encontrou = true;
-            p.quantidade += quantidadeAdicionada;
-            std::cout << "? Adicao de " << quantidadeAdicionada << " unidades de '" << p.nome << "' realizada com sucesso!" << std::endl;
-            registrarMovimentacao(p, quantidadeAdicionada, "ENTRADA");
-            salvarProdutosNoArquivo(produtos);
-            break;
+int executarBenchmark(int argc, char* argv[], bool durabilidadeEscolhida) {
+    ConfiguracaoBenchmark config = {{10000, 1000000, 10000000}, 8, 40, false, 1, 5, 1000, 100000, "", "",
+                                    "benchmark_estoque"};
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const char* opcao = argv[i];
+        const char* valor = argv[i + 1];
+        if (strcmp(opcao, "--tamanhos") == 0) {
+            config.tamanhos.clear();
+            for (const char* p = valor; *p != '\0'; ) {
+                char* fim;
+                unsigned long long tamanho = strtoull(p, &fim, 10);
+                if (fim == p || tamanho == 0 || tamanho > INT_MAX) {
+                    std::cerr << "Lista de tamanhos invalida: " << valor << "\n";
+                    return 1;
+                }
+                config.tamanhos.push_back(static_cast<size_t>(tamanho));
+                p = *fim == ',' ? fim + 1 : fim;
+            }
+        } else if (strcmp(opcao, "--nome-min") == 0) {
+            config.nomeMinimo = atoi(valor);
+        } else if (strcmp(opcao, "--nome-max") == 0) {
+            config.nomeMaximo = atoi(valor);
+        } else if (strcmp(opcao, "--nome-dist") == 0) {
+            config.nomeNormal = strcmp(valor, "normal") == 0;
+        } else if (strcmp(opcao, "--aquecimento") == 0) {
+            config.aquecimento = std::max(0, atoi(valor));
+        } else if (strcmp(opcao, "--repeticoes") == 0) {
+            config.repeticoes = std::max(1, atoi(valor));
+        } else if (strcmp(opcao, "--operacoes") == 0) {
+            config.operacoesPorRodada = std::max(2, atoi(valor));
+        } else if (strcmp(opcao, "--lote") == 0) {
+            config.movimentosNoLote = std::max(2, atoi(valor));
+        } else if (strcmp(opcao, "--csv") == 0) {
+            config.arquivoCsv = valor;
+        } else if (strcmp(opcao, "--json") == 0) {
+            config.arquivoJson = valor;
+        } else if (strcmp(opcao, "--diretorio") == 0) {
+            config.diretorio = valor;
+        } else {
+            std::cerr << "Opcao de benchmark desconhecida: " << opcao << "\n";
+            return 1;
         }
     }
+    // Nomes entre 1 e o limite do Produto; o minimo precisa caber o " <ID>"
+    config.nomeMaximo = std::max(1, std::min(config.nomeMaximo, MAX_NOME - 1));
+    config.nomeMinimo = std::max(1, std::min(config.nomeMinimo, config.nomeMaximo));
 
-    if (!encontrou) {
-        std::cout << "? Produto nao encontrado!" << std::endl;
+    // Sem --durabilidade, mede o codigo e nao o disco: nada de flush por
+    // movimentacao
+    if (!durabilidadeEscolhida) {
+        catalogo.escritorLog.configurar(DURABILIDADE_NENHUMA, 0);
     }
-}
 
-// 6. SYSTEM CALLS: Criacao, leitura e escrita - Geracao de relatorio
-void gerarRelatorio() {
-    std::cout << "\n=== GERANDO RELATORIO DO ESTOQUE ===\n";
+    // SYSTEM CALL: GetCurrentDirectory / CreateDirectory / SetCurrentDirectory
+    // Todo o trabalho acontece em um diretorio proprio; os resultados sao
+    // gravados depois de voltar ao diretorio original
+    char diretorioOriginal[MAX_PATH];
+    GetCurrentDirectoryA(sizeof(diretorioOriginal), diretorioOriginal);
+    if (!CreateDirectoryA(config.diretorio.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+        tratarErro("criar diretorio do benchmark");
+        return 1;
+    }
+    if (!SetCurrentDirectoryA(config.diretorio.c_str())) {
+        tratarErro("entrar no diretorio do benchmark");
+        return 1;
+    }
 
-    std::vector<Produto> produtos = lerProdutosDoArquivo();
-    if (produtos.empty()) {
-        std::cout << "Estoque vazio ou erro ao ler o arquivo." << std::endl;
-        return;
+    printf("=== BENCHMARK DO ESTOQUE ===\n");
+    printf("Kernel: %s | durabilidade: %s | nomes: %d a %d (%s) | aquecimento: %d | repeticoes: %d\n",
+           kernelsEstoque().nome, nomeDoModo(catalogo.escritorLog.modoAtual()), config.nomeMinimo,
+           config.nomeMaximo, config.nomeNormal ? "normal" : "uniforme", config.aquecimento, config.repeticoes);
+    printf("%10s  %-14s %8s %12s %12s %12s %12s\n", "produtos", "operacao", "amostras", "p50 (us)", "p99 (us)",
+           "max (us)", "media (us)");
+
+    std::vector<ResultadoBenchmark> resultados;
+    for (size_t tamanho : config.tamanhos) {
+        executarBenchmarkTamanho(tamanho, config, resultados);
     }
 
-    // SYSTEM CALL: CreateFile - Cria o arquivo de relatorio
-    HANDLE hRelatorio = CreateFileA(
-        ARQUIVO_RELATORIO,
-        GENERIC_WRITE,
-        0,
-        NULL,
-        CREATE_ALWAYS,       // Sempre cria um novo arquivo, sobrescrevendo se existir
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
+    SetCurrentDirectoryA(diretorioOriginal);
+    RemoveDirectoryA(config.diretorio.c_str()); // So sai se tiver ficado vazio
 
-    if (hRelatorio == INVALID_HANDLE_VALUE) {
-        tratarErro("criar arquivo de relatorio");
-        return;
+    bool gravado = true;
+    if (!config.arquivoCsv.empty()) {
+        gravado = gravarTextoNoArquivo(config.arquivoCsv.c_str(), resultadosEmCsv(resultados)) && gravado;
+    }
+    if (!config.arquivoJson.empty()) {
+        gravado = gravarTextoNoArquivo(config.arquivoJson.c_str(), resultadosEmJson(resultados, config)) && gravado;
     }
+    return gravado ? 0 : 1;
+}
 
-    // Prepara o conteudo do relatorio
-    char relatorio[2000];
-    int totalProdutos = produtos.size();
-    int totalQuantidade = 0;
-    int produtosBaixoEstoque = 0;
+// === MODO SERVIDOR (VARIAS SESSOES SIMULTANEAS) ===
+// Executa um comando do protocolo texto e devolve a resposta (uma linha):
+//   ENTRADA <id> <qtd> | SAIDA <id> <qtd> | CONSULTA <id> | MINIMO <id> <qtd>
+//   RESUMO | ESTATISTICAS
+//   CADASTRO <id> <qtd> <preco> <nome...> | AJUDA | SAIR
+std::string executarComando(const std::string& linha, bool& encerrarSessao) {
+    char comando[16] = "";
+    int id = 0, quantidade = 0;
+    int lidos = sscanf_s(linha.c_str(), "%15s %d %d", comando, (int)sizeof(comando), &id, &quantidade);
+    if (lidos < 1) {
+        return "";
+    }
+    std::string cmd = comando;
+    std::transform(cmd.begin(), cmd.end(), cmd.begin(), [](unsigned char c){ return std::toupper(c); });
 
-    for (const auto& p : produtos) {
-        totalQuantidade += p.quantidade;
-        if (p.quantidade < 10) { // Exemplo: produtos com menos de 10 unidades
-            produtosBaixoEstoque++;
+    char resposta[MAX_NOME + 80];
+    if ((cmd == "ENTRADA" || cmd == "SAIDA") && lidos == 3) {
+        Produto p;
+        switch (aplicarMovimentacao(id, quantidade, cmd == "ENTRADA", &p)) {
+            case MOV_OK:
+                sprintf_s(resposta, sizeof(resposta), "OK %s %d | %s | saldo %d", cmd.c_str(), id, p.nome, p.quantidade);
+                break;
+            case MOV_PRODUTO_NAO_ENCONTRADO:
+                sprintf_s(resposta, sizeof(resposta), "ERRO produto %d nao encontrado", id);
+                break;
+            case MOV_QUANTIDADE_INVALIDA:
+                sprintf_s(resposta, sizeof(resposta), "ERRO quantidade deve ser maior que zero");
+                break;
+            case MOV_SALDO_INSUFICIENTE:
+                sprintf_s(resposta, sizeof(resposta), "ERRO saldo insuficiente | disponivel %d", p.quantidade);
+                break;
+            case MOV_SALDO_EXCEDIDO:
+                sprintf_s(resposta, sizeof(resposta), "ERRO saldo passaria do limite | atual %d", p.quantidade);
+                break;
+            case MOV_NAO_CONFIRMADA:
+                sprintf_s(resposta, sizeof(resposta), "AVISO %s %d aplicada, mas nao confirmada no disco | saldo %d",
+                          cmd.c_str(), id, p.quantidade);
+                break;
+            default:
+                sprintf_s(resposta, sizeof(resposta), "ERRO movimentacao nao registrada");
+                break;
+        }
+        realizarCheckpointSeNecessario();
+        return resposta;
+    }
+    if (cmd == "CONSULTA" && lidos >= 2) {
+        // Leitura: catalogo compartilhado + fragmento do produto
+        std::shared_lock<std::shared_mutex> travaCatalogo(catalogo.mutexCatalogo);
+        int slot = catalogo.indice.buscar(id);
+        if (slot < 0) {
+            sprintf_s(resposta, sizeof(resposta), "ERRO produto %d nao encontrado", id);
+            return resposta;
+        }
+        std::lock_guard<std::mutex> travaProduto(catalogo.fragmentos[slot & (NUM_FRAGMENTOS - 1)].mtx);
+        const ColunasProdutos& produtos = catalogo.produtos;
+        sprintf_s(resposta, sizeof(resposta), "OK %d | %s | saldo %d | R$ %.2f", produtos.ids[slot],
+                  produtos.nome(slot), produtos.quantidades[slot], produtos.preco(slot));
+        return resposta;
+    }
+    if (cmd == "MINIMO" && lidos == 3) {
+        Produto p;
+        ResultadoMovimentacao r = definirEstoqueMinimo(id, quantidade, &p);
+        if (r == MOV_OK) {
+            sprintf_s(resposta, sizeof(resposta), "OK MINIMO %d | %s | minimo %d", id, p.nome, p.estoqueMinimo);
+        } else if (r == MOV_NAO_CONFIRMADA) {
+            sprintf_s(resposta, sizeof(resposta), "AVISO MINIMO %d aplicado, mas nao confirmado no disco | minimo %d",
+                      id, p.estoqueMinimo);
+        } else if (r == MOV_PRODUTO_NAO_ENCONTRADO) {
+            sprintf_s(resposta, sizeof(resposta), "ERRO produto %d nao encontrado", id);
+        } else {
+            sprintf_s(resposta, sizeof(resposta), "ERRO estoque minimo nao alterado");
         }
+        realizarCheckpointSeNecessario();
+        return resposta;
     }
+    if (cmd == "ESTATISTICAS") {
+        return "OK " + catalogo.escritorLog.resumoEstatisticas();
+    }
+    if (cmd == "RESUMO") {
+        // Agregados incrementais: O(1), sem travar o catalogo
+        long long valor = catalogo.valorTotalCentavos.load();
+        sprintf_s(resposta, sizeof(resposta), "OK itens %lld | valor R$%lld.%02lld | abaixo do minimo %lld",
+                  catalogo.totalQuantidade.load(), valor / 100, llabs(valor % 100),
+                  catalogo.produtosBaixoEstoque.load());
+        return resposta;
+    }
+    if (cmd == "CADASTRO") {
+        Produto novo;
+        int consumidos = 0;
+        if (sscanf_s(linha.c_str(), "%*s %d %d %lf %n", &novo.id, &novo.quantidade, &novo.preco, &consumidos) != 3 ||
+            consumidos == 0 || linha.size() <= static_cast<size_t>(consumidos)) {
+            return "ERRO uso: CADASTRO <id> <quantidade> <preco> <nome>";
+        }
+        strncpy_s(novo.nome, linha.c_str() + consumidos, MAX_NOME - 1);
+        novo.estoqueMinimo = ESTOQUE_MINIMO_PADRAO;
+        if (!precoCabeNaColuna(novo.preco)) {
+            return "ERRO preco fora da faixa suportada";
+        }
+        return gravarNovoProduto(novo) ? "OK produto cadastrado" : "ERRO ID ja cadastrado ou falha ao gravar";
+    }
+    if (cmd == "SAIR") {
+        encerrarSessao = true;
+        return "OK ate logo";
+    }
+    return "ERRO comandos: ENTRADA <id> <qtd> | SAIDA <id> <qtd> | CONSULTA <id> | MINIMO <id> <qtd> | "
+           "RESUMO | ESTATISTICAS | CADASTRO <id> <qtd> <preco> <nome> | SAIR";
+}
 
-    sprintf_s(relatorio, sizeof(relatorio),
-              "=== RELATORIO DO ESTOQUE ===\n\n"
-              "Gerado em: [Data e Hora Atual]\n" // Em uma versao real, voce usaria uma funcao de data/hora
-              "----------------------------------------\n"
-              "RESUMO\n"
-              "Total de tipos de produtos: %d\n"
-              "Quantidade total de itens: %d\n"
-              "Produtos com baixo estoque (<10 un.): %d\n"
-              "----------------------------------------\n\n"
-              "LISTAGEM DETALHADA DE PRODUTOS\n",
-              totalProdutos, totalQuantidade, produtosBaixoEstoque);
+// Atende um cliente conectado ao pipe ate ele sair ou desconectar
+void atenderSessaoPipe(HANDLE hPipe) {
+    std::string pendente;
+    char buffer[4096];
+    bool encerrar = false;
 
-    DWORD bytesEscritos;
-    // SYSTEM CALL: WriteFile - Escreve o cabecalho do relatorio
-    WriteFile(hRelatorio, relatorio, strlen(relatorio), &bytesEscritos, NULL);
+    while (!encerrar) {
+        DWORD bytesLidos = 0;
+        if (!ReadFile(hPipe, buffer, sizeof(buffer), &bytesLidos, NULL) || bytesLidos == 0) {
+            break; // Cliente desconectou
+        }
+        pendente.append(buffer, bytesLidos);
 
-    // Escreve os detalhes de cada produto
-    for (const auto& p : produtos) {
-        char linha[MAX_NOME + 50];
-        sprintf_s(linha, sizeof(linha), "ID: %d | Nome: %s | Qtd: %d | Preco: R$%.2f\n",
-                  p.id, p.nome, p.quantidade, p.preco);
-        WriteFile(hRelatorio, linha, strlen(linha), &bytesEscritos, NULL);
+        // Cada linha completa e um comando
+        size_t fimLinha;
+        while (!encerrar && (fimLinha = pendente.find('\n')) != std::string::npos) {
+            std::string linha = pendente.substr(0, fimLinha);
+            pendente.erase(0, fimLinha + 1);
+            if (!linha.empty() && linha.back() == '\r') {
+                linha.pop_back();
+            }
+            std::string resposta = executarComando(linha, encerrar) + "\n";
+            DWORD bytesEscritos;
+            WriteFile(hPipe, resposta.data(), (DWORD)resposta.size(), &bytesEscritos, NULL);
+        }
     }
 
-    // SYSTEM CALL: CloseHandle
-    CloseHandle(hRelatorio);
-    std::cout << "? Relatorio gerado em '" << ARQUIVO_RELATORIO << "'" << std::endl;
+    DisconnectNamedPipe(hPipe);
+    CloseHandle(hPipe);
 }
 
-// Funcao auxiliar para ler todos os produtos do arquivo para a memoria
-std::vector<Produto> lerProdutosDoArquivo() {
-    std::vector<Produto> produtos;
-    HANDLE hArquivo = CreateFileA(
-        ARQUIVO_ESTOQUE,
-        GENERIC_READ,
-        FILE_SHARE_READ,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
-
-    if (hArquivo == INVALID_HANDLE_VALUE) {
-        return produtos; // Retorna um vetor vazio
+// Descritor de seguranca do pipe: so o usuario que iniciou o servidor (e o
+// SYSTEM) abre o pipe, e logons de rede sao negados. Liberar com LocalFree.
+static bool criarSegurancaDoPipe(SECURITY_ATTRIBUTES& atributos) {
+    HANDLE hToken;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &hToken)) {
+        return false;
     }
-
-    DWORD tamanhoArquivo = GetFileSize(hArquivo, NULL);
-    if (tamanhoArquivo == 0) {
-        CloseHandle(hArquivo);
-        return produtos;
+    DWORD tamanho = 0;
+    GetTokenInformation(hToken, TokenUser, NULL, 0, &tamanho);
+    std::vector<BYTE> usuario(tamanho);
+    char* sid = NULL;
+    bool lido = tamanho > 0 && GetTokenInformation(hToken, TokenUser, usuario.data(), tamanho, &tamanho) &&
+                ConvertSidToStringSidA(reinterpret_cast<TOKEN_USER*>(usuario.data())->User.Sid, &sid);
+    CloseHandle(hToken);
+    if (!lido) {
+        return false;
     }
 
-    char* buffer = new char[tamanhoArquivo + 1];
-    DWORD bytesLidos;
+    // D:P = DACL protegida (sem heranca); NU = logon de rede, SY = SYSTEM
+    std::string sddl = std::string("D:P(D;;GA;;;NU)(A;;GA;;;SY)(A;;GA;;;") + sid + ")";
+    LocalFree(sid);
+    atributos.nLength = sizeof(atributos);
+    atributos.bInheritHandle = FALSE;
+    atributos.lpSecurityDescriptor = NULL;
+    return ConvertStringSecurityDescriptorToSecurityDescriptorA(sddl.c_str(), SDDL_REVISION_1,
+                                                                &atributos.lpSecurityDescriptor, NULL) != FALSE;
+}
 
-    ReadFile(hArquivo, buffer, tamanhoArquivo, &bytesLidos, NULL);
-    buffer[bytesLidos] = '\0';
-    CloseHandle(hArquivo);
+// Cria uma instancia do pipe por cliente e dispara uma thread por sessao.
+// O pipe e so local: clientes remotos (SMB) sao recusados pelo modo do pipe
+// e pelo descritor de seguranca.
+void aceitarClientesPipe() {
+    SECURITY_ATTRIBUTES seguranca;
+    if (!criarSegurancaDoPipe(seguranca)) {
+        tratarErro("montar descritor de seguranca do pipe");
+        return;
+    }
 
-    char* linha = strtok(buffer, "\n");
-    while (linha != NULL) {
-        if (strlen(linha) > 0) {
-            Produto p;
-            sscanf_s(linha, "%d|%99[^|]|%d|%lf", &p.id, p.nome, (int)sizeof(p.nome), &p.quantidade, &p.preco);
-            produtos.push_back(p);
+    while (true) {
+        // SYSTEM CALL: CreateNamedPipe - Nova instancia do pipe para o proximo cliente
+        HANDLE hPipe = CreateNamedPipeA(
+            NOME_PIPE,
+            PIPE_ACCESS_DUPLEX,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES,
+            4096,
+            4096,
+            0,
+            &seguranca
+        );
+        if (hPipe == INVALID_HANDLE_VALUE) {
+            tratarErro("criar named pipe");
+            LocalFree(seguranca.lpSecurityDescriptor);
+            return;
         }
-        linha = strtok(NULL, "\n");
-    }
 
-    delete[] buffer;
-    return produtos;
+        // SYSTEM CALL: ConnectNamedPipe - Bloqueia ate um cliente se conectar
+        BOOL conectado = ConnectNamedPipe(hPipe, NULL) ? TRUE : (GetLastError() == ERROR_PIPE_CONNECTED);
+        if (conectado) {
+            std::thread(atenderSessaoPipe, hPipe).detach();
+        } else {
+            CloseHandle(hPipe);
+        }
+    }
 }
 
-// Funcao auxiliar para salvar todos os produtos de volta no arquivo
-void salvarProdutosNoArquivo(const std::vector<Produto>& produtos) {
-    HANDLE hArquivo = CreateFileA(
-        ARQUIVO_ESTOQUE,
-        GENERIC_WRITE,
-        0,
-        NULL,
-        CREATE_ALWAYS, // Sobrescreve o arquivo existente
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
+// Servidor: o console e uma sessao e cada cliente do pipe e outra, todas
+// atuando sobre o mesmo catalogo em memoria
+int executarServidor() {
+    garantirCatalogoAtualizado();
+    std::cout << "=== SERVIDOR DE ESTOQUE ===\n";
+    std::cout << catalogo.produtos.tamanho() << " produto(s) carregado(s). Aguardando clientes em "
+              << NOME_PIPE << "\n";
+    std::cout << "Digite comandos aqui mesmo (AJUDA) ou SAIR para encerrar o servidor.\n";
 
-    if (hArquivo == INVALID_HANDLE_VALUE) {
-        tratarErro("salvar dados no arquivo");
-        return;
-    }
+    std::thread(aceitarClientesPipe).detach();
 
-    for (const auto& p : produtos) {
-        char linha[MAX_NOME + 50];
-        sprintf_s(linha, sizeof(linha), "%d|%s|%d|%.2f\n",
-                  p.id, p.nome, p.quantidade, p.preco);
-        DWORD bytesEscritos;
-        WriteFile(hArquivo, linha, strlen(linha), &bytesEscritos, NULL);
+    bool encerrar = false;
+    std::string linha;
+    while (!encerrar && std::getline(std::cin, linha)) {
+        std::string resposta = executarComando(linha, encerrar);
+        if (!resposta.empty()) {
+            std::cout << resposta << std::endl;
+        }
     }
 
-    CloseHandle(hArquivo);
+    // Espera as movimentacoes em andamento e consolida o log antes de sair
+    std::unique_lock<std::shared_mutex> trava(catalogo.mutexCatalogo);
+    if (catalogo.movimentacoesPendentes > 0) {
+        realizarCheckpoint();
+    }
+    catalogo.escritorLog.exibirEstatisticas();
+    std::cout << "Servidor encerrado.\n";
+    return 0;
 }
 
-// Funcao auxiliar para registrar uma movimentacao em um arquivo separado
-void registrarMovimentacao(const Produto& produto, int quantidade, const std::string& tipo) {
-    HANDLE hArquivo = CreateFileA(
-        ARQUIVO_MOVIMENTACOES,
-        GENERIC_WRITE,
-        FILE_SHARE_READ,
-        NULL,
-        OPEN_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
+// Cliente: envia cada linha digitada ao servidor e mostra a resposta
+int executarCliente() {
+    HANDLE hPipe = CreateFileA(NOME_PIPE, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (hPipe == INVALID_HANDLE_VALUE) {
+        tratarErro("conectar ao servidor de estoque");
+        return 1;
+    }
+    std::cout << "Conectado ao servidor de estoque. Digite AJUDA para ver os comandos.\n";
 
-    if (hArquivo != INVALID_HANDLE_VALUE) {
-        SetFilePointer(hArquivo, 0, NULL, FILE_END);
-        char linha[MAX_NOME + 50];
-        // Em uma versao real, voce usaria uma funcao de data/hora
-        sprintf_s(linha, sizeof(linha), "Tipo: %s | ID: %d | Nome: %s | Qtd: %d | Data: [atual]\n",
-                  tipo.c_str(), produto.id, produto.nome, quantidade);
-        DWORD bytesEscritos;
-        WriteFile(hArquivo, linha, strlen(linha), &bytesEscritos, NULL);
-        CloseHandle(hArquivo);
+    std::string linha;
+    std::string pendente;
+    char buffer[4096];
+    bool encerrar = false;
+    while (!encerrar && std::getline(std::cin, linha)) {
+        std::string comando = linha + "\n";
+        DWORD bytes;
+        if (!WriteFile(hPipe, comando.data(), (DWORD)comando.size(), &bytes, NULL)) {
+            break;
+        }
+        // Le ate receber a linha de resposta completa
+        size_t fimLinha;
+        while ((fimLinha = pendente.find('\n')) == std::string::npos) {
+            if (!ReadFile(hPipe, buffer, sizeof(buffer), &bytes, NULL) || bytes == 0) {
+                encerrar = true;
+                break;
+            }
+            pendente.append(buffer, bytes);
+        }
+        if (fimLinha != std::string::npos) {
+            std::string resposta = pendente.substr(0, fimLinha);
+            std::cout << resposta << std::endl;
+            pendente.erase(0, fimLinha + 1);
+            encerrar = resposta.compare(0, 11, "OK ate logo") == 0;
+        }
     }
+
+    CloseHandle(hPipe);
+    return 0;
 }
 
 // Funcao para exibir o menu principal
@@ -490,12 +4078,79 @@ void exibirMenu() {
     std::cout << "4. Listar Todos os Produtos\n";
     std::cout << "5. Buscar Produto\n";
     std::cout << "6. Gerar Relatorio de Estoque\n";
+    std::cout << "7. Converter Estoque (Texto/Binario)\n";
+    std::cout << "8. Definir Estoque Minimo\n";
+    std::cout << "9. Verificar Totais do Estoque\n";
     std::cout << "0. Sair\n";
     std::cout << "Escolha uma opcao: ";
 }
 
 // Funcao principal do programa
-int main() {
+int main(int argc, char* argv[]) {
+    // Opcoes do log de movimentacoes, antes do modo de execucao:
+    //   --durabilidade nenhuma|movimento|grupo   (padrao: grupo)
+    //   --janela-ms N                            (janela do grupo, padrao: 2)
+    // e dos kernels de totalizacao:
+    //   --kernel auto|escalar|avx2               (padrao: auto)
+    ModoDurabilidade modo = DURABILIDADE_GRUPO;
+    double janelaMs = 2.0;
+    bool durabilidadeEscolhida = false;
+    while (argc >= 3 && (strcmp(argv[1], "--durabilidade") == 0 || strcmp(argv[1], "--janela-ms") == 0 ||
+                         strcmp(argv[1], "--kernel") == 0)) {
+        durabilidadeEscolhida = durabilidadeEscolhida || strcmp(argv[1], "--durabilidade") == 0;
+        if (strcmp(argv[1], "--janela-ms") == 0) {
+            janelaMs = atof(argv[2]);
+        } else if (strcmp(argv[1], "--kernel") == 0) {
+            if (strcmp(argv[2], "escalar") == 0) {
+                kernelsAtivos = &KERNELS_ESCALAR;
+            } else if (strcmp(argv[2], "avx2") == 0 && processadorTemAvx2()) {
+                kernelsAtivos = &KERNELS_AVX2;
+            } else if (strcmp(argv[2], "auto") != 0) {
+                std::cerr << "Kernel invalido ou sem suporte neste processador: " << argv[2]
+                          << " (auto, escalar ou avx2)\n";
+                return 1;
+            }
+        } else if (strcmp(argv[2], "nenhuma") == 0) {
+            modo = DURABILIDADE_NENHUMA;
+        } else if (strcmp(argv[2], "movimento") == 0) {
+            modo = DURABILIDADE_POR_MOVIMENTACAO;
+        } else if (strcmp(argv[2], "grupo") == 0) {
+            modo = DURABILIDADE_GRUPO;
+        } else {
+            std::cerr << "Modo de durabilidade invalido: " << argv[2] << " (nenhuma, movimento ou grupo)\n";
+            return 1;
+        }
+        // Consome a opcao e o valor; o restante segue como antes
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    catalogo.escritorLog.configurar(modo, static_cast<int>(janelaMs * 1000));
+
+    // Modo lote: aplica um arquivo de movimentacoes sem passar pelo menu
+    if (argc >= 3 && strcmp(argv[1], "--lote") == 0) {
+        std::string rejeitados = argc >= 4 ? argv[3] : std::string(argv[2]) + ".rejeitados";
+        return processarLoteDeMovimentacoes(argv[2], rejeitados.c_str());
+    }
+    if (argc >= 2 && strcmp(argv[1], "--historico") == 0) {
+        return executarConsultaHistorico(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--converter-historico") == 0) {
+        return converterHistoricoLegado(argc >= 3 ? argv[2] : ARQUIVO_MOVIMENTACOES);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--verificar") == 0) {
+        return verificarAgregados();
+    }
+    if (argc >= 2 && strcmp(argv[1], "--benchmark") == 0) {
+        return executarBenchmark(argc, argv, durabilidadeEscolhida);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--servidor") == 0) {
+        return executarServidor();
+    }
+    if (argc >= 2 && strcmp(argv[1], "--cliente") == 0) {
+        return executarCliente();
+    }
+
     int opcao;
     std::cout << "??? SISTEMA DE CONTROLE DE ESTOQUE ???\n";
     std::cout << "=====================================\n";
@@ -526,7 +4181,21 @@ int main() {
             case 6:
                 gerarRelatorio();
                 break;
+            case 7:
+                converterEstoque();
+                break;
+            case 8:
+                configurarEstoqueMinimo();
+                break;
+            case 9:
+                verificarAgregados();
+                break;
             case 0:
+                // Consolida o log no arquivo de estoque antes de sair
+                if (catalogo.movimentacoesPendentes > 0) {
+                    realizarCheckpoint();
+                }
+                catalogo.escritorLog.exibirEstatisticas();
                 std::cout << "?? Encerrando sistema... Ate logo!\n";
                 break;
             default:
@@ -0,0 +1,204 @@
+//=============================================================================
+// FILA LIMITADA GENERICA
+// FilaLimitada<T, Capacidade>: a fila do produtor-consumidor (mutex + duas
+// variaveis de condicao) como template reutilizavel, so de cabecalho.
+//
+//   - T pode ser so-movivel (sem construtor de copia);
+//   - os elementos sao construidos direto no slot (inserir_no_lugar) e saem
+//     com um unico movimento (retirar); o armazenamento e um vetor fixo de
+//     Capacidade slots dentro do proprio objeto, sem alocar nada depois de
+//     construida;
+//   - tentar_* nao esperam; *_por esperam no maximo um prazo;
+//   - fechar() acorda todo mundo: insercoes passam a falhar e as retiradas
+//     so falham depois que a fila esvaziar.
+//
+// Com Capacidade * sizeof(T) grande, crie a fila no heap (std::make_unique)
+// e nao na pilha.
+//=============================================================================
+
+#ifndef FILA_LIMITADA_HPP
+#define FILA_LIMITADA_HPP
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+template <typename T, std::size_t Capacidade>
+class FilaLimitada {
+    static_assert(Capacidade > 0, "FilaLimitada precisa de pelo menos 1 slot");
+    static_assert(std::is_move_assignable<T>::value, "T precisa poder ser movido para fora da fila");
+
+public:
+    FilaLimitada() = default;
+    FilaLimitada(const FilaLimitada&) = delete;
+    FilaLimitada& operator=(const FilaLimitada&) = delete;
+
+    ~FilaLimitada() {
+        while (tamanho_atual > 0) {
+            slot(inicio)->~T();
+            inicio = proximo(inicio);
+            --tamanho_atual;
+        }
+    }
+
+    // --- Insercao: constroi T(argumentos...) no slot livre ---
+
+    // Espera haver espaco; false se a fila foi (ou for) fechada
+    template <typename... Argumentos>
+    bool inserir_no_lugar(Argumentos&&... argumentos) {
+        std::unique_lock<std::mutex> lock(mtx);
+        esperar(lock, cv_produtor, produtores_esperando, [this] { return tamanho_atual < Capacidade || esta_fechada; });
+        return construir_sob_trava(std::forward<Argumentos>(argumentos)...);
+    }
+
+    // Nao espera: false com a fila cheia ou fechada
+    template <typename... Argumentos>
+    bool tentar_inserir_no_lugar(Argumentos&&... argumentos) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return construir_sob_trava(std::forward<Argumentos>(argumentos)...);
+    }
+
+    // Espera no maximo 'prazo'; false se o tempo acabou ou a fila fechou
+    template <typename Rep, typename Periodo, typename... Argumentos>
+    bool tentar_inserir_no_lugar_por(const std::chrono::duration<Rep, Periodo>& prazo,
+                                     Argumentos&&... argumentos) {
+        std::unique_lock<std::mutex> lock(mtx);
+        esperar_por(lock, cv_produtor, produtores_esperando, prazo,
+                    [this] { return tamanho_atual < Capacidade || esta_fechada; });
+        return construir_sob_trava(std::forward<Argumentos>(argumentos)...);
+    }
+
+    bool inserir(T&& valor) { return inserir_no_lugar(std::move(valor)); }
+    bool tentar_inserir(T&& valor) { return tentar_inserir_no_lugar(std::move(valor)); }
+
+    // --- Retirada: move o elemento mais antigo para 'destino' ---
+
+    // Espera haver elemento; false so com a fila fechada e vazia
+    bool retirar(T& destino) {
+        std::unique_lock<std::mutex> lock(mtx);
+        esperar(lock, cv_consumidor, consumidores_esperando, [this] { return tamanho_atual > 0 || esta_fechada; });
+        return mover_sob_trava(destino);
+    }
+
+    // Nao espera: false com a fila vazia
+    bool tentar_retirar(T& destino) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return mover_sob_trava(destino);
+    }
+
+    template <typename Rep, typename Periodo>
+    bool tentar_retirar_por(T& destino, const std::chrono::duration<Rep, Periodo>& prazo) {
+        std::unique_lock<std::mutex> lock(mtx);
+        esperar_por(lock, cv_consumidor, consumidores_esperando, prazo,
+                    [this] { return tamanho_atual > 0 || esta_fechada; });
+        return mover_sob_trava(destino);
+    }
+
+    // --- Encerramento ---
+
+    void fechar() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            esta_fechada = true;
+        }
+        cv_produtor.notify_all();
+        cv_consumidor.notify_all();
+    }
+
+    bool fechada() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return esta_fechada;
+    }
+
+    std::size_t tamanho() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return tamanho_atual;
+    }
+
+    static constexpr std::size_t capacidade() { return Capacidade; }
+
+private:
+    // Espera a condicao contando quem esta dormindo, para que o outro lado
+    // so notifique quando houver alguem para acordar
+    template <typename Condicao>
+    void esperar(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int& esperando,
+                 Condicao condicao) {
+        while (!condicao()) {
+            ++esperando;
+            cv.wait(lock);
+            --esperando;
+        }
+    }
+
+    template <typename Rep, typename Periodo, typename Condicao>
+    void esperar_por(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int& esperando,
+                     const std::chrono::duration<Rep, Periodo>& prazo, Condicao condicao) {
+        auto limite = std::chrono::steady_clock::now() + prazo;
+        while (!condicao()) {
+            ++esperando;
+            std::cv_status status = cv.wait_until(lock, limite);
+            --esperando;
+            if (status == std::cv_status::timeout) {
+                break; // O chamador confere de novo o estado da fila
+            }
+        }
+    }
+
+    template <typename... Argumentos>
+    bool construir_sob_trava(Argumentos&&... argumentos) {
+        if (esta_fechada || tamanho_atual == Capacidade) {
+            return false;
+        }
+        // Se o construtor de T lancar excecao, a fila fica como estava
+        ::new (static_cast<void*>(armazenamento[proximo_livre()])) T(std::forward<Argumentos>(argumentos)...);
+        ++tamanho_atual;
+        if (consumidores_esperando > 0) {
+            cv_consumidor.notify_one();
+        }
+        return true;
+    }
+
+    bool mover_sob_trava(T& destino) {
+        if (tamanho_atual == 0) {
+            return false;
+        }
+        T* elemento = slot(inicio);
+        destino = std::move(*elemento);
+        elemento->~T();
+        inicio = proximo(inicio);
+        --tamanho_atual;
+        if (produtores_esperando > 0) {
+            cv_produtor.notify_one();
+        }
+        return true;
+    }
+
+    static std::size_t proximo(std::size_t posicao) { return posicao + 1 == Capacidade ? 0 : posicao + 1; }
+
+    std::size_t proximo_livre() const {
+        std::size_t posicao = inicio + tamanho_atual;
+        return posicao >= Capacidade ? posicao - Capacidade : posicao;
+    }
+
+    // Objeto vivo no slot (o launder e exigido ao acessar um objeto criado
+    // por placement new atraves da memoria crua)
+    T* slot(std::size_t posicao) { return std::launder(reinterpret_cast<T*>(armazenamento[posicao])); }
+
+    // Memoria crua para Capacidade objetos T: so os slots entre 'inicio' e
+    // 'inicio + tamanho_atual' (circular) tem objetos vivos
+    alignas(T) unsigned char armazenamento[Capacidade][sizeof(T)];
+    std::size_t inicio = 0;
+    std::size_t tamanho_atual = 0;
+    bool esta_fechada = false;
+    int produtores_esperando = 0;
+    int consumidores_esperando = 0;
+    mutable std::mutex mtx;
+    std::condition_variable cv_produtor;
+    std::condition_variable cv_consumidor;
+};
+
+#endif // FILA_LIMITADA_HPP
@@ -0,0 +1,474 @@
+//=============================================================================
+// PIPELINE DE ESTAGIOS
+// O produtor-consumidor em varios saltos: fonte -> estagio 1 -> ... ->
+// estagio N, cada ligacao uma FilaLimitada (FilaLimitada.hpp). Cada
+// estagio tem quantas threads trabalhadoras quiser e pode preservar a ordem
+// de chegada na saida. As filas limitadas propagam a contrapressao: um
+// estagio lento enche a sua fila de entrada, que trava o anterior, ate a
+// fonte.
+//
+// Modos:
+//   PipelineEstagios            pipeline de exemplo (interpretar ->
+//                               enriquecer -> agregar -> gravar) e as
+//                               metricas de cada estagio
+//   PipelineEstagios --escala   vazao variando as threads do estagio lento
+//
+// Opcoes: [--itens N] [--trabalhadores N] [--custo N] [--sem-ordem]
+//=============================================================================
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+
+#include "FilaLimitada.hpp"
+
+// === EVENTO QUE ATRAVESSA O PIPELINE ===
+// Um registro de venda: chega como linha de texto e cada estagio preenche
+// uma parte
+const int NUM_REGIOES = 5;
+const char* const NOMES_REGIOES[NUM_REGIOES] = {"Norte", "Nordeste", "Centro-Oeste", "Sudeste", "Sul"};
+
+struct Evento {
+    long sequencia = 0;       // Ordem em que a fonte gerou
+    std::string linha;        // "cliente;produto;quantidade;preco_centavos"
+    int cliente = 0;          // Preenchidos por 'interpretar'
+    int produto = 0;
+    int quantidade = 0;
+    long preco_centavos = 0;
+    int regiao = -1;          // Preenchidos por 'enriquecer'
+    uint64_t assinatura = 0;
+};
+
+// Capacidade de cada fila entre estagios (fixa em tempo de compilacao)
+const size_t CAPACIDADE_ENTRE_ESTAGIOS = 64;
+typedef FilaLimitada<Evento, CAPACIDADE_ENTRE_ESTAGIOS> FilaDeEventos;
+
+// Relogio monotonico, em ns
+inline int64_t agora_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// === REORDENACAO ===
+// Com varias threads num estagio, os eventos terminam fora de ordem. Cada
+// evento recebe um numero ao entrar no estagio; ao sair, espera numa janela
+// circular ate que todos os anteriores tenham saido. A janela e limitada:
+// quem esta adiantado demais espera (contrapressao tambem aqui), e como os
+// numeros sao dados na ordem da fila de entrada, o evento mais atrasado ja
+// esta com alguma thread e sempre cabe na janela.
+class Reordenador {
+public:
+    explicit Reordenador(FilaDeEventos& saida) : saida(saida), pendentes(JANELA), ocupados(JANELA, false) {}
+
+    // Devolve o tempo (ns) que a thread ficou presa aqui: esperando a
+    // vez, a janela ou a fila de saida
+    int64_t entregar(long numero, Evento&& evento) {
+        int64_t chegada = agora_ns();
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&]() { return numero < proximo + JANELA; });
+        pendentes[numero % JANELA] = std::move(evento);
+        ocupados[numero % JANELA] = true;
+        // Quem completa a sequencia despacha tudo que estiver pronto; a
+        // insercao pode travar com a fila de saida cheia (contrapressao)
+        while (ocupados[proximo % JANELA]) {
+            ocupados[proximo % JANELA] = false;
+            saida.inserir(std::move(pendentes[proximo % JANELA]));
+            ++proximo;
+        }
+        cv.notify_all();
+        return agora_ns() - chegada;
+    }
+
+private:
+    static const long JANELA = 256;
+
+    FilaDeEventos& saida;
+    std::vector<Evento> pendentes;
+    std::vector<bool> ocupados;
+    long proximo = 0;
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
+// === PIPELINE ===
+typedef std::function<void(Evento&)> FuncaoEstagio;
+
+// Tempos somados de todas as threads de um estagio
+struct MetricasEstagio {
+    long long itens = 0;
+    int64_t ocupado_ns = 0;            // Dentro da funcao do estagio
+    int64_t esperando_entrada_ns = 0;  // Fila de entrada vazia (estagio ocioso)
+    int64_t bloqueado_saida_ns = 0;    // Fila de saida cheia (contrapressao)
+};
+
+// Profundidade de uma fila, amostrada periodicamente
+struct AmostrasFila {
+    long long soma = 0;
+    long long amostras = 0;
+    size_t maximo = 0;
+};
+
+class Pipeline {
+public:
+    // Estagios sao executados na ordem em que forem adicionados; o ultimo
+    // nao tem fila de saida (e o sumidouro). Com preservar_ordem, a saida
+    // do estagio sai na mesma ordem da entrada. A ordem e refeita na entrega
+    // a fila seguinte, entao no sumidouro ela so vale com 1 thread (que ja
+    // consome na ordem): executar() recusa o sumidouro com preservar_ordem e
+    // varias threads. A funcao precisa ser segura para o numero de threads
+    // pedido (estado compartilhado: 1 thread).
+    void adicionar_estagio(const std::string& nome, int trabalhadores, bool preservar_ordem, FuncaoEstagio funcao) {
+        std::unique_ptr<Estagio> estagio(new Estagio);
+        estagio->nome = nome;
+        estagio->trabalhadores = std::max(1, trabalhadores);
+        estagio->preservar_ordem = preservar_ordem;
+        estagio->funcao = funcao;
+        estagios.push_back(std::move(estagio));
+    }
+
+    // Roda ate a fonte devolver false e todos os eventos passarem pelo
+    // ultimo estagio; devolve o tempo decorrido em segundos
+    double executar(std::function<bool(Evento&)> fonte) {
+        size_t n = estagios.size();
+        const Estagio& sumidouro = *estagios[n - 1];
+        if (sumidouro.preservar_ordem && sumidouro.trabalhadores > 1) {
+            throw std::invalid_argument("preservar_ordem no ultimo estagio ('" + sumidouro.nome +
+                                        "') so e possivel com 1 thread");
+        }
+        filas.clear();
+        for (size_t i = 0; i < n; ++i) {
+            filas.emplace_back(new FilaDeEventos()); // filas[i] = entrada do estagio i
+        }
+        for (size_t i = 0; i < n; ++i) {
+            Estagio& estagio = *estagios[i];
+            estagio.metricas = MetricasEstagio();
+            estagio.proximo_numero = 0;
+            estagio.ativos = estagio.trabalhadores;
+            estagio.reordenador.reset(i + 1 < n && estagio.preservar_ordem && estagio.trabalhadores > 1
+                                          ? new Reordenador(*filas[i + 1]) : nullptr);
+        }
+        profundidades.assign(n, AmostrasFila());
+        fonte_bloqueada_ns = 0;
+
+        auto inicio = std::chrono::steady_clock::now();
+        std::atomic<bool> terminou{false};
+        std::thread monitor([&]() { amostrar_filas(terminou); });
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < n; ++i) {
+            for (int t = 0; t < estagios[i]->trabalhadores; ++t) {
+                threads.emplace_back([this, i]() { trabalhar(i); });
+            }
+        }
+
+        // A fonte roda nesta thread
+        Evento evento;
+        for (long sequencia = 0; fonte(evento); ++sequencia) {
+            evento.sequencia = sequencia;
+            if (!filas[0]->tentar_inserir(std::move(evento))) {
+                int64_t espera = agora_ns();
+                filas[0]->inserir(std::move(evento));
+                fonte_bloqueada_ns += agora_ns() - espera;
+            }
+            evento = Evento();
+        }
+        filas[0]->fechar();
+
+        for (auto& t : threads) {
+            t.join();
+        }
+        std::chrono::duration<double> segundos = std::chrono::steady_clock::now() - inicio;
+        terminou = true;
+        monitor.join();
+        return segundos.count();
+    }
+
+    // Tabela por estagio. O gargalo e o estagio com a maior ocupacao por
+    // thread: a fila de entrada dele fica cheia e as seguintes, vazias.
+    void exibir_metricas(double segundos) const {
+        std::printf(" %-12s %7s %12s %9s %9s %9s %16s\n", "estagio", "threads", "itens/s", "ocupado", "ocioso",
+                    "travado", "fila entrada");
+        size_t gargalo = 0;
+        double maior_ocupacao = -1;
+        for (size_t i = 0; i < estagios.size(); ++i) {
+            double ocupacao = ocupacao_por_thread(i, segundos);
+            if (ocupacao > maior_ocupacao) {
+                maior_ocupacao = ocupacao;
+                gargalo = i;
+            }
+        }
+        for (size_t i = 0; i < estagios.size(); ++i) {
+            const Estagio& estagio = *estagios[i];
+            const MetricasEstagio& m = estagio.metricas;
+            double tempo_threads = segundos * 1e9 * estagio.trabalhadores;
+            const AmostrasFila& fila = profundidades[i];
+            double profundidade_media = fila.amostras > 0 ? static_cast<double>(fila.soma) / fila.amostras : 0;
+            std::printf(" %-12s %7d %12.0f %8.1f%% %8.1f%% %8.1f%% %7.1f (max %2zu)%s\n", estagio.nome.c_str(),
+                        estagio.trabalhadores, m.itens / segundos, 100.0 * m.ocupado_ns / tempo_threads,
+                        100.0 * m.esperando_entrada_ns / tempo_threads, 100.0 * m.bloqueado_saida_ns / tempo_threads,
+                        profundidade_media, fila.maximo, i == gargalo ? "  <- gargalo" : "");
+        }
+        std::printf(" fonte travada pela contrapressao: %.1f%% do tempo\n", 100.0 * fonte_bloqueada_ns / (segundos * 1e9));
+    }
+
+    // Nome do estagio com a maior ocupacao por thread
+    std::string nome_do_gargalo(double segundos) const {
+        size_t gargalo = 0;
+        for (size_t i = 1; i < estagios.size(); ++i) {
+            if (ocupacao_por_thread(i, segundos) > ocupacao_por_thread(gargalo, segundos)) {
+                gargalo = i;
+            }
+        }
+        return estagios[gargalo]->nome;
+    }
+
+private:
+    struct Estagio {
+        std::string nome;
+        int trabalhadores = 1;
+        bool preservar_ordem = false;
+        FuncaoEstagio funcao;
+        MetricasEstagio metricas;          // Protegidas por mtx
+        std::unique_ptr<Reordenador> reordenador;
+        long proximo_numero = 0;           // Protegido por mtx_entrada
+        int ativos = 0;                    // Protegido por mtx
+        std::mutex mtx_entrada;            // Retirada + numeracao atomicas juntas
+        std::mutex mtx;
+    };
+
+    void trabalhar(size_t i) {
+        Estagio& estagio = *estagios[i];
+        FilaDeEventos& entrada = *filas[i];
+        FilaDeEventos* saida = i + 1 < estagios.size() ? filas[i + 1].get() : nullptr;
+        MetricasEstagio local;
+        Evento evento;
+        for (;;) {
+            // 1. Retirada (so numera quando a ordem vai ser reconstruida)
+            long numero = 0;
+            bool obteve;
+            int64_t inicio = agora_ns();
+            if (estagio.reordenador) {
+                std::lock_guard<std::mutex> lock(estagio.mtx_entrada);
+                obteve = entrada.retirar(evento);
+                numero = estagio.proximo_numero++;
+            } else {
+                obteve = entrada.retirar(evento);
+            }
+            int64_t retirado = agora_ns();
+            local.esperando_entrada_ns += retirado - inicio;
+            if (!obteve) {
+                break; // Fila fechada e vazia: o estagio anterior acabou
+            }
+
+            // 2. Trabalho
+            estagio.funcao(evento);
+            int64_t processado = agora_ns();
+            local.ocupado_ns += processado - retirado;
+            ++local.itens;
+
+            // 3. Entrega ao proximo estagio
+            if (estagio.reordenador) {
+                local.bloqueado_saida_ns += estagio.reordenador->entregar(numero, std::move(evento));
+            } else if (saida && !saida->tentar_inserir(std::move(evento))) {
+                saida->inserir(std::move(evento));
+                local.bloqueado_saida_ns += agora_ns() - processado;
+            }
+        }
+
+        // A ultima thread do estagio fecha a fila seguinte
+        std::lock_guard<std::mutex> lock(estagio.mtx);
+        estagio.metricas.itens += local.itens;
+        estagio.metricas.ocupado_ns += local.ocupado_ns;
+        estagio.metricas.esperando_entrada_ns += local.esperando_entrada_ns;
+        estagio.metricas.bloqueado_saida_ns += local.bloqueado_saida_ns;
+        if (--estagio.ativos == 0 && saida) {
+            saida->fechar();
+        }
+    }
+
+    void amostrar_filas(const std::atomic<bool>& terminou) {
+        while (!terminou) {
+            for (size_t i = 0; i < filas.size(); ++i) {
+                size_t tamanho = filas[i]->tamanho();
+                profundidades[i].soma += tamanho;
+                ++profundidades[i].amostras;
+                profundidades[i].maximo = std::max(profundidades[i].maximo, tamanho);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    double ocupacao_por_thread(size_t i, double segundos) const {
+        return estagios[i]->metricas.ocupado_ns / (segundos * 1e9 * estagios[i]->trabalhadores);
+    }
+
+    std::vector<std::unique_ptr<Estagio>> estagios;
+    std::vector<std::unique_ptr<FilaDeEventos>> filas;
+    std::vector<AmostrasFila> profundidades; // Escritas so pelo monitor
+    int64_t fonte_bloqueada_ns = 0;
+};
+
+// === PIPELINE DE EXEMPLO ===
+// interpretar (barato) -> enriquecer (caro, varias threads) -> agregar
+// (estado compartilhado, 1 thread) -> gravar (confere ordem e totais)
+struct ConfiguracaoExemplo {
+    long itens;
+    int trabalhadores_enriquecer;
+    int custo_enriquecer;       // Rodadas de calculo por evento no estagio lento
+    bool preservar_ordem;
+};
+
+struct ResultadoExemplo {
+    double segundos;
+    bool correto;
+};
+
+// Gerador deterministico (LCG) para a fonte
+static uint32_t proximo_aleatorio(uint32_t& estado) {
+    estado = estado * 1664525u + 1013904223u;
+    return estado >> 8;
+}
+
+static ResultadoExemplo executar_exemplo(const ConfiguracaoExemplo& config, bool exibir) {
+    // Totais por regiao: esperados (calculados pela fonte) e obtidos (pelo agregador)
+    long long esperado[NUM_REGIOES] = {0};
+    long long agregado[NUM_REGIOES] = {0};
+    long gerados = 0;
+    uint32_t estado = 12345;
+    long gravados = 0;
+    long ultima_sequencia = -1;
+    bool em_ordem = true;
+
+    Pipeline pipeline;
+    pipeline.adicionar_estagio("interpretar", 1, false, [](Evento& e) {
+        char* cursor = &e.linha[0];
+        e.cliente = static_cast<int>(std::strtol(cursor, &cursor, 10));
+        e.produto = static_cast<int>(std::strtol(cursor + 1, &cursor, 10));
+        e.quantidade = static_cast<int>(std::strtol(cursor + 1, &cursor, 10));
+        e.preco_centavos = std::strtol(cursor + 1, &cursor, 10);
+    });
+    int custo = config.custo_enriquecer;
+    pipeline.adicionar_estagio("enriquecer", config.trabalhadores_enriquecer, config.preservar_ordem,
+                               [custo](Evento& e) {
+        e.regiao = e.cliente % NUM_REGIOES;
+        // Simula a consulta cara (cadastro, geolocalizacao...): um hash em
+        // 'custo' rodadas
+        uint64_t h = static_cast<uint64_t>(e.cliente) * 0x9E3779B97F4A7C15ull + e.produto;
+        for (int r = 0; r < custo; ++r) {
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDull;
+        }
+        e.assinatura = h;
+    });
+    pipeline.adicionar_estagio("agregar", 1, false, [&agregado](Evento& e) {
+        agregado[e.regiao] += static_cast<long long>(e.quantidade) * e.preco_centavos;
+    });
+    pipeline.adicionar_estagio("gravar", 1, false, [&](Evento& e) {
+        if (e.sequencia <= ultima_sequencia) {
+            em_ordem = false;
+        }
+        ultima_sequencia = e.sequencia;
+        ++gravados;
+    });
+
+    double segundos = pipeline.executar([&](Evento& e) {
+        if (gerados == config.itens) {
+            return false;
+        }
+        int cliente = static_cast<int>(proximo_aleatorio(estado) % 100000);
+        int produto = static_cast<int>(proximo_aleatorio(estado) % 5000);
+        int quantidade = 1 + static_cast<int>(proximo_aleatorio(estado) % 20);
+        long preco = 100 + static_cast<long>(proximo_aleatorio(estado) % 100000);
+        e.linha = std::to_string(cliente) + ";" + std::to_string(produto) + ";" + std::to_string(quantidade) + ";" +
+                  std::to_string(preco);
+        esperado[cliente % NUM_REGIOES] += static_cast<long long>(quantidade) * preco;
+        ++gerados;
+        return true;
+    });
+
+    bool totais_corretos = std::equal(esperado, esperado + NUM_REGIOES, agregado);
+    bool ordem_correta = em_ordem || !config.preservar_ordem;
+    bool correto = gravados == config.itens && totais_corretos && ordem_correta;
+    if (exibir) {
+        pipeline.exibir_metricas(segundos);
+        std::printf("\n Total: %ld eventos em %.3f s (%.0f eventos/s)\n", gravados, segundos, gravados / segundos);
+        for (int r = 0; r < NUM_REGIOES; ++r) {
+            std::printf("   %-13s R$ %16.2f\n", NOMES_REGIOES[r], agregado[r] / 100.0);
+        }
+        std::printf(" Totais %s | ordem na saida: %s\n", totais_corretos ? "conferem" : "NAO CONFEREM",
+                    !config.preservar_ordem ? "nao exigida" : (em_ordem ? "preservada" : "VIOLADA"));
+    } else {
+        std::printf(" %2d threads em 'enriquecer': %10.0f eventos/s | gargalo: %s\n",
+                    config.trabalhadores_enriquecer, gravados / segundos, pipeline.nome_do_gargalo(segundos).c_str());
+    }
+    if (!correto) {
+        std::cerr << "ERRO: eventos perdidos, totais errados ou ordem violada.\n";
+    }
+    return {segundos, correto};
+}
+
+// === FUNCAO PRINCIPAL ===
+int main(int argc, char* argv[]) {
+    ConfiguracaoExemplo config = {200000, 2, 2000, true};
+    bool escala = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string opcao = argv[i];
+        if (opcao == "--escala") {
+            escala = true;
+            continue;
+        }
+        if (opcao == "--sem-ordem") {
+            config.preservar_ordem = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Falta o valor de " << opcao << "\n";
+            return 1;
+        }
+        const char* valor = argv[++i];
+        if (opcao == "--itens") {
+            config.itens = std::max(1L, std::atol(valor));
+        } else if (opcao == "--trabalhadores") {
+            config.trabalhadores_enriquecer = std::max(1, std::atoi(valor));
+        } else if (opcao == "--custo") {
+            config.custo_enriquecer = std::max(0, std::atoi(valor));
+        } else {
+            std::cerr << "Opcao desconhecida: " << opcao << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "========================================================\n";
+    std::cout << " PIPELINE: interpretar -> enriquecer -> agregar -> gravar\n";
+    std::cout << " Eventos: " << config.itens << " | Custo de 'enriquecer': " << config.custo_enriquecer
+              << " | Filas: " << CAPACIDADE_ENTRE_ESTAGIOS << " | Ordem: "
+              << (config.preservar_ordem ? "preservada" : "livre") << "\n";
+    std::cout << "========================================================\n";
+
+    if (!escala) {
+        return executar_exemplo(config, true).correto ? 0 : 1;
+    }
+
+    // Dobra as threads do estagio lento ate o dobro dos nucleos: a vazao
+    // cresce ate o gargalo mudar de estagio ou faltarem nucleos
+    bool correto = true;
+    int limite = 2 * static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int trabalhadores = 1; trabalhadores <= limite; trabalhadores *= 2) {
+        ConfiguracaoExemplo execucao = config;
+        execucao.trabalhadores_enriquecer = trabalhadores;
+        correto = executar_exemplo(execucao, false).correto && correto;
+    }
+    return correto ? 0 : 1;
+}
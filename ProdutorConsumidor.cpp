@@ -1,6 +1,15 @@
 //=============================================================================
 // PROBLEMA DO PRODUTOR-CONSUMIDOR
 // Demonstrao de Sincronizao com std::thread, std::mutex e std::condition_variable
+//
+// Modos:
+//   ProdutorConsumidor                 simulacao didatica (com atrasos e mensagens)
+//   ProdutorConsumidor --silencioso    a mesma simulacao sem mensagens, so com
+//                                      os histogramas de latencia no fim
+//   ProdutorConsumidor --mensagens     FilaLimitada<T, N> (FilaLimitada.hpp) com
+//                                      mensagens so-moviveis de 4 KB
+//   ProdutorConsumidor --benchmark     vazao da fila com mutex x filas sem travas
+//                                      (anel 1x1 e MPMC com N produtores/M consumidores)
 //=============================================================================
 
 #include <iostream>
@@ -9,6 +18,26 @@
 #include <condition_variable>
 #include <vector>
 #include <chrono>
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+#include <memory>
+#include <new>
+
+#include "FilaLimitada.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h> // _mm_pause
+#endif
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>   // GetProcessTimes
+#endif
 
 // === ESPECIFICAES ===
 // Tamanho maximo do buffer (memoria compartilhada)
@@ -16,31 +45,171 @@ const int TAMANHO_BUFFER = 5;
 // Numero total de itens a serem produzidos e consumidos
 const int MAX_ITENS = 12;      
 
+// === MEDICAO DE LATENCIA ===
+// Tamanho da linha de cache: dados escritos por threads diferentes ficam
+// em linhas separadas, senao cada escrita invalida a linha da outra thread
+// (falso compartilhamento)
+const size_t LINHA_DE_CACHE = 64;
+
+// Relogio monotonico (nao anda para tras com ajustes de hora), em ns
+inline int64_t agora_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// O que circula pelas filas: o valor e o instante em que entrou na fila
+struct Item {
+    int valor;
+    int64_t enfileirado_ns;
+};
+
+// Percentis de um histograma, em nanossegundos
+struct ResumoLatencia {
+    uint64_t contagem;
+    uint64_t p50, p90, p99, p999, maximo;
+};
+
+// Histograma no estilo HDR: faixas com largura proporcional ao valor (32
+// subfaixas por potencia de 2, erro relativo de ~3%), de 1 ns ate ~73 min,
+// em memoria fixa. Cada thread registra no seu proprio histograma (um so
+// escritor), entao registrar() nao precisa de trava nem de operacao
+// atomica de leitura-modificacao-escrita; os contadores sao atomicos so
+// para poderem ser lidos por outra thread.
+class alignas(LINHA_DE_CACHE) HistogramaLatencia {
+public:
+    HistogramaLatencia() {
+        for (auto& c : contagens) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void registrar(int64_t nanossegundos) {
+        uint64_t valor = nanossegundos > 0 ? static_cast<uint64_t>(nanossegundos) : 0;
+        auto& contagem = contagens[faixa_do_valor(valor)];
+        contagem.store(contagem.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (valor > maximo.load(std::memory_order_relaxed)) {
+            maximo.store(valor, std::memory_order_relaxed);
+        }
+    }
+
+    // Soma outro histograma neste (depois que as threads terminaram)
+    void acumular(const HistogramaLatencia& outro) {
+        for (int i = 0; i < NUM_FAIXAS; ++i) {
+            contagens[i].store(contagens[i].load(std::memory_order_relaxed) +
+                               outro.contagens[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        maximo.store(std::max(maximo.load(), outro.maximo.load()), std::memory_order_relaxed);
+    }
+
+    ResumoLatencia resumir() const {
+        uint64_t total = 0;
+        for (const auto& c : contagens) {
+            total += c.load(std::memory_order_relaxed);
+        }
+        ResumoLatencia resumo = {total, percentil(0.50, total), percentil(0.90, total), percentil(0.99, total),
+                                 percentil(0.999, total), maximo.load()};
+        return resumo;
+    }
+
+private:
+    static const int BITS_SUBFAIXA = 5;
+    static const int SUBFAIXAS = 1 << BITS_SUBFAIXA;
+    static const int MAIOR_EXPOENTE = 42; // Valores abaixo de 2^42 ns
+    static const int NUM_FAIXAS = (MAIOR_EXPOENTE - BITS_SUBFAIXA + 1) * SUBFAIXAS;
+
+    // Faixa = (expoente, 5 bits seguintes ao bit mais alto do valor)
+    static int faixa_do_valor(uint64_t valor) {
+        valor = std::min<uint64_t>(valor, (1ull << MAIOR_EXPOENTE) - 1);
+        if (valor < SUBFAIXAS) {
+            return static_cast<int>(valor);
+        }
+        int expoente = 0; // Posicao do bit mais alto
+        for (int passo = 32; passo > 0; passo /= 2) {
+            if (valor >> (expoente + passo)) {
+                expoente += passo;
+            }
+        }
+        int deslocamento = expoente - BITS_SUBFAIXA;
+        return (deslocamento + 1) * SUBFAIXAS + static_cast<int>((valor >> deslocamento) & (SUBFAIXAS - 1));
+    }
+
+    // Maior valor que cai na faixa (os percentis saem como limite superior)
+    static uint64_t limite_da_faixa(int faixa) {
+        if (faixa < SUBFAIXAS) {
+            return static_cast<uint64_t>(faixa);
+        }
+        int deslocamento = faixa / SUBFAIXAS - 1;
+        uint64_t inicio = static_cast<uint64_t>(SUBFAIXAS + faixa % SUBFAIXAS) << deslocamento;
+        return inicio + (1ull << deslocamento) - 1;
+    }
+
+    uint64_t percentil(double fracao, uint64_t total) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t posto = std::max<uint64_t>(1, static_cast<uint64_t>(fracao * total + 0.999999));
+        uint64_t acumulado = 0;
+        for (int i = 0; i < NUM_FAIXAS; ++i) {
+            acumulado += contagens[i].load(std::memory_order_relaxed);
+            if (acumulado >= posto) {
+                return std::min(limite_da_faixa(i), maximo.load());
+            }
+        }
+        return maximo.load();
+    }
+
+    std::atomic<uint64_t> contagens[NUM_FAIXAS];
+    std::atomic<uint64_t> maximo{0};
+};
+
+// Uma linha com os percentis em microssegundos
+void exibir_latencia(const char* nome, const ResumoLatencia& r) {
+    std::printf("      %-30s n=%-10llu p50 %9.2f | p90 %9.2f | p99 %9.2f | p99.9 %9.2f | max %9.2f us\n", nome,
+                static_cast<unsigned long long>(r.contagem), r.p50 / 1000.0, r.p90 / 1000.0, r.p99 / 1000.0,
+                r.p999 / 1000.0, r.maximo / 1000.0);
+}
+
 // === RECURSOS COMPARTILHADOS ===
-std::vector<int> buffer;             // O buffer compartilhado (memoria compartilhada)
+std::vector<Item> buffer;            // O buffer compartilhado (memoria compartilhada)
 std::mutex mtx;                      // Mutex para exclusao mutua (protege o buffer)
 std::condition_variable cv_produtor; // Variavel de condicao para o produtor (buffer cheio)
 std::condition_variable cv_consumidor; // Variavel de condicao para o consumidor (buffer vazio)
 
+// Medicao: cada histograma tem uma so thread escrevendo
+bool modo_silencioso = false;          // --silencioso: sem mensagens durante a simulacao
+HistogramaLatencia latencia_itens;     // Consumidor: do push_back ate a retirada
+HistogramaLatencia espera_produtor;    // Produtor: tempo bloqueado com o buffer cheio
+HistogramaLatencia espera_consumidor;  // Consumidor: tempo bloqueado com o buffer vazio
+
 // === FUNCAO DO PRODUTOR ===
 void produtor() {
     for (int i = 1; i <= MAX_ITENS; ++i) {
         // 1. Bloqueio do Mutex e Preparacao para Condicao
         std::unique_lock<std::mutex> lock(mtx);
         
-        std::cout << "\n[PROD] -> Tentando produzir item " << i << ". Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << "..." << std::endl;
+        if (!modo_silencioso) {
+            std::cout << "\n[PROD] -> Tentando produzir item " << i << ". Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << "..." << std::endl;
+        }
 
         // 2. Sincronizacao: Espera se o buffer estiver cheio
         // Se o buffer estiver cheio, o produtor e bloqueado.
-        while (buffer.size() == TAMANHO_BUFFER) {
-            std::cout << "[PROD] !! Buffer CHEIO. Produtor BLOQUEADO (Aguarda Consumidor)." << std::endl;
-            // O produtor espera na cv_produtor, liberando o 'lock' enquanto espera.
-            cv_produtor.wait(lock); 
+        if (buffer.size() == TAMANHO_BUFFER) {
+            int64_t inicio_espera = agora_ns();
+            while (buffer.size() == TAMANHO_BUFFER) {
+                if (!modo_silencioso) {
+                    std::cout << "[PROD] !! Buffer CHEIO. Produtor BLOQUEADO (Aguarda Consumidor)." << std::endl;
+                }
+                // O produtor espera na cv_produtor, liberando o 'lock' enquanto espera.
+                cv_produtor.wait(lock);
+            }
+            espera_produtor.registrar(agora_ns() - inicio_espera);
         }
 
-        // 3. Secao Critica: Produzir o item
-        buffer.push_back(i);
-        std::cout << "[PROD] ++ Item " << i << " PROD. Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << std::endl;
+        // 3. Secao Critica: Produzir o item (carimbado com o instante em que entra no buffer)
+        buffer.push_back({i, agora_ns()});
+        if (!modo_silencioso) {
+            std::cout << "[PROD] ++ Item " << i << " PROD. Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << std::endl;
+        }
 
         // Adiciona um pequeno delay para melhor visualizacao da sincronizacao
         std::this_thread::sleep_for(std::chrono::milliseconds(100)); 
@@ -60,20 +229,31 @@ void consumidor() {
         // 1. Bloqueio do Mutex e Preparacao para Condicao
         std::unique_lock<std::mutex> lock(mtx);
 
-        std::cout << "\n[CONS] <- Tentando consumir item. Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << "..." << std::endl;
+        if (!modo_silencioso) {
+            std::cout << "\n[CONS] <- Tentando consumir item. Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << "..." << std::endl;
+        }
 
         // 2. Sincronizacao: Espera se o buffer estiver vazio
         // Se o buffer estiver vazio, o consumidor e bloqueado.
-        while (buffer.empty()) {
-            std::cout << "[CONS] -- Buffer VAZIO. Consumidor BLOQUEADO (Aguarda Produtor)." << std::endl;
-            // O consumidor espera na cv_consumidor, liberando o 'lock' enquanto espera.
-            cv_consumidor.wait(lock);
+        if (buffer.empty()) {
+            int64_t inicio_espera = agora_ns();
+            while (buffer.empty()) {
+                if (!modo_silencioso) {
+                    std::cout << "[CONS] -- Buffer VAZIO. Consumidor BLOQUEADO (Aguarda Produtor)." << std::endl;
+                }
+                // O consumidor espera na cv_consumidor, liberando o 'lock' enquanto espera.
+                cv_consumidor.wait(lock);
+            }
+            espera_consumidor.registrar(agora_ns() - inicio_espera);
         }
 
         // 3. Secao Critica: Consumir o item
-        int item_consumido = buffer.front();
+        Item item_consumido = buffer.front();
         buffer.erase(buffer.begin()); // Remove o primeiro item (FIFO)
-        std::cout << "[CONS] -- Item " << item_consumido << " CONS. Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << std::endl;
+        latencia_itens.registrar(agora_ns() - item_consumido.enfileirado_ns);
+        if (!modo_silencioso) {
+            std::cout << "[CONS] -- Item " << item_consumido.valor << " CONS. Buffer: " << buffer.size() << "/" << TAMANHO_BUFFER << std::endl;
+        }
 
         // Adiciona um pequeno delay para melhor visualizacao da sincronizacao
         std::this_thread::sleep_for(std::chrono::milliseconds(400)); 
@@ -84,8 +264,1281 @@ void consumidor() {
     }
 }
 
+// === FILAS PARA MEDICAO DE DESEMPENHO ===
+// A simulacao acima e didatica: os sleeps e as mensagens dominam o tempo.
+// Para medir a vazao, as duas filas abaixo tem a mesma interface
+// (inserir/retirar bloqueantes) e podem ser trocadas uma pela outra.
+
+// Quantas vezes as threads acordaram/esperaram umas pelas outras. So
+// contam as notificacoes feitas com alguem esperando: sao as que viram
+// chamada de sistema (futex no Linux, WakeByAddress no Windows), assim como
+// cada espera. Nas filas sem travas a espera e um yield, que tambem e uma
+// chamada de sistema.
+struct ContadoresFila {
+    long long notificacoes;
+    long long esperas;
+};
+
+// === ESTRATEGIAS DE ESPERA ===
+// O que uma fila sem travas faz quando esta cheia (produtor) ou vazia
+// (consumidor). Cada estrategia recebe uma 'tentativa' (a operacao nao
+// bloqueante da fila, que devolve true quando conseguiu) e so retorna
+// depois que ela der certo; avisar() e chamado pelo outro lado depois de
+// mover itens. A escolha e entre gastar processador girando e pagar a ida
+// ao nucleo do sistema (dormir e ser acordado custa algumas dezenas de us).
+
+// Instrucao de pausa do processador dentro de um laco de espera: alivia o
+// nucleo vizinho (hyperthreading) e evita a penalidade de saida do laco
+inline void pausa_de_cpu() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Onde as threads dormem: mutex + variavel de condicao (futex no Linux,
+// WaitOnAddress no Windows). Quem vai dormir anota a geracao, liga
+// 'alguem_dormindo' e refaz a tentativa; so dorme se a geracao nao mudou.
+// Quem avisa publica o item e, se o sinal estiver ligado, desliga-o,
+// avanca a geracao com o mutex e notifica. As duas cercas seq_cst
+// garantem que ou quem avisa ve o sinal, ou quem dorme ve o item: o aviso
+// nunca se perde. Cada ida dormir custa no maximo uma notificacao (o sinal
+// e consumido por quem notifica), e sem ninguem dormindo avisar custa so
+// uma cerca e uma leitura. A tentativa roda fora do mutex: ela avisa o
+// outro lado da fila, e segurar um mutex enquanto trava o do outro lado
+// poderia travar os dois.
+class Estacionamento {
+public:
+    template <typename Tentativa>
+    void dormir_ate(Tentativa tentativa) {
+        for (;;) {
+            unsigned observada = geracao.load(std::memory_order_acquire);
+            alguem_dormindo.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (tentativa()) {
+                return; // O sinal pode ficar ligado: custa no maximo um aviso a toa
+            }
+            std::unique_lock<std::mutex> lock(mtx);
+            while (geracao.load(std::memory_order_relaxed) == observada) {
+                esperas.fetch_add(1, std::memory_order_relaxed);
+                cv.wait(lock);
+            }
+        }
+    }
+
+    void acordar() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (alguem_dormindo.load(std::memory_order_relaxed) && alguem_dormindo.exchange(false)) {
+            std::lock_guard<std::mutex> lock(mtx);
+            geracao.fetch_add(1, std::memory_order_release);
+            notificacoes.fetch_add(1, std::memory_order_relaxed);
+            cv.notify_all(); // Varios produtores (ou consumidores) podem estar dormindo
+        }
+    }
+
+    ContadoresFila contadores() const { return {notificacoes.load(), esperas.load()}; }
+
+private:
+    std::atomic<bool> alguem_dormindo{false};
+    std::atomic<unsigned> geracao{0};
+    std::atomic<long long> notificacoes{0};
+    std::atomic<long long> esperas{0};
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
+// Dorme ja na primeira falha: o comportamento da fila com variavel de condicao
+class EsperaBloqueante {
+public:
+    template <typename Tentativa>
+    void esperar(Tentativa tentativa) {
+        if (!tentativa()) {
+            estacionamento.dormir_ate(tentativa);
+        }
+    }
+
+    void avisar() { estacionamento.acordar(); }
+    ContadoresFila contadores() const { return estacionamento.contadores(); }
+
+private:
+    Estacionamento estacionamento;
+};
+
+// Gira sem nunca largar o processador, com pausas que dobram a cada
+// tentativa ate um teto (o laco fica limitado a ~64 pausas entre leituras
+// da fila, para nao martelar a linha de cache que o outro lado escreve)
+class EsperaGirando {
+public:
+    template <typename Tentativa>
+    void esperar(Tentativa tentativa) {
+        for (int pausas = 1; !tentativa(); pausas = std::min(pausas * 2, MAXIMO_DE_PAUSAS)) {
+            for (int i = 0; i < pausas; ++i) {
+                pausa_de_cpu();
+            }
+        }
+    }
+
+    void avisar() {}
+    ContadoresFila contadores() const { return {0, 0}; }
+
+private:
+    static const int MAXIMO_DE_PAUSAS = 64;
+};
+
+// Gira 'Giros' vezes e depois cede o processador (yield) a cada tentativa.
+// Com Giros = 0 e o que as filas sem travas sempre fizeram.
+template <int Giros>
+class EsperaGiraCede {
+public:
+    template <typename Tentativa>
+    void esperar(Tentativa tentativa) {
+        for (int i = 0; i < Giros; ++i) {
+            if (tentativa()) {
+                return;
+            }
+            pausa_de_cpu();
+        }
+        while (!tentativa()) {
+            cedencias.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    void avisar() {}
+    ContadoresFila contadores() const { return {0, cedencias.load()}; }
+
+private:
+    std::atomic<long long> cedencias{0}; // So mexido no caminho lento
+};
+
+typedef EsperaGiraCede<0> EsperaCedendo;
+typedef EsperaGiraCede<1000> EsperaGiraDepoisCede;
+
+// Gira um numero fixo de vezes e depois dorme
+class EsperaGiraDorme {
+public:
+    template <typename Tentativa>
+    void esperar(Tentativa tentativa) {
+        for (int i = 0; i < GIROS; ++i) {
+            if (tentativa()) {
+                return;
+            }
+            pausa_de_cpu();
+        }
+        estacionamento.dormir_ate(tentativa);
+    }
+
+    void avisar() { estacionamento.acordar(); }
+    ContadoresFila contadores() const { return estacionamento.contadores(); }
+
+private:
+    static const int GIROS = 1000;
+    Estacionamento estacionamento;
+};
+
+// Gira-e-dorme com orcamento de giros ajustado pelas esperas recentes:
+//   - espera resolvida girando, com g giros: o orcamento anda 1/8 em
+//     direcao a 2g (media movel), sobrando folga sobre o tipico;
+//   - espera que chegou a dormir e acordou rapido (menos que o custo de
+//     dormir): girar um pouco mais teria evitado a ida ao sistema, dobra;
+//   - dormiu por muito tempo: girar foi desperdicio, corta pela metade.
+// O orcamento e compartilhado pelas threads do mesmo lado da fila.
+class EsperaAdaptativa {
+public:
+    template <typename Tentativa>
+    void esperar(Tentativa tentativa) {
+        if (tentativa()) {
+            return;
+        }
+        int orcamento_atual = orcamento.load(std::memory_order_relaxed);
+        for (int giros = 1; giros <= orcamento_atual; ++giros) {
+            pausa_de_cpu();
+            if (tentativa()) {
+                ajustar(orcamento_atual + (2 * giros - orcamento_atual) / 8);
+                return;
+            }
+        }
+        int64_t inicio = agora_ns();
+        estacionamento.dormir_ate(tentativa);
+        bool acordou_rapido = agora_ns() - inicio < CUSTO_DE_DORMIR_NS;
+        ajustar(acordou_rapido ? orcamento_atual * 2 : orcamento_atual / 2);
+    }
+
+    void avisar() { estacionamento.acordar(); }
+    ContadoresFila contadores() const { return estacionamento.contadores(); }
+
+private:
+    static const int ORCAMENTO_MINIMO = 16;
+    static const int ORCAMENTO_MAXIMO = 1 << 16;
+    static const int64_t CUSTO_DE_DORMIR_NS = 50000;
+
+    void ajustar(int novo) {
+        orcamento.store(std::max(ORCAMENTO_MINIMO, std::min(ORCAMENTO_MAXIMO, novo)), std::memory_order_relaxed);
+    }
+
+    std::atomic<int> orcamento{ORCAMENTO_MINIMO * 16};
+    Estacionamento estacionamento;
+};
+
+// Soma dos contadores das esperas dos dois lados de uma fila
+inline ContadoresFila somar_contadores(const ContadoresFila& a, const ContadoresFila& b) {
+    return {a.notificacoes + b.notificacoes, a.esperas + b.esperas};
+}
+
+// Versao original: a mesma logica de produtor()/consumidor() (vector usado
+// como FIFO, mutex e duas variaveis de condicao), sem sleeps e sem mensagens.
+// inserir/retirar travam e notificam a cada item, como no original;
+// inserir_lote/retirar_lote movem varios itens por travamento e so notificam
+// nas transicoes vazia -> nao vazia e cheia -> nao cheia, e so se houver
+// alguem esperando (quem espera so dorme nessas duas situacoes).
+// As versoes tentar_* nao esperam: retornam false/0 com a fila cheia/vazia.
+class FilaMutex {
+public:
+    explicit FilaMutex(size_t capacidade) : capacidade(capacidade) {}
+
+    void inserir(const Item& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (buffer.size() == capacidade) {
+            ++contadores.esperas;
+            ++produtores_esperando;
+            cv_produtor.wait(lock);
+            --produtores_esperando;
+        }
+        inserir_um_sob_trava(item);
+    }
+
+    Item retirar() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (buffer.empty()) {
+            ++contadores.esperas;
+            ++consumidores_esperando;
+            cv_consumidor.wait(lock);
+            --consumidores_esperando;
+        }
+        return retirar_um_sob_trava();
+    }
+
+    bool tentar_inserir(const Item& item) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (buffer.size() == capacidade) {
+            return false;
+        }
+        inserir_um_sob_trava(item);
+        return true;
+    }
+
+    bool tentar_retirar(Item& item) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (buffer.empty()) {
+            return false;
+        }
+        item = retirar_um_sob_trava();
+        return true;
+    }
+
+    // Insere os n itens, esperando por espaco quantas vezes for preciso
+    void inserir_lote(const Item* itens, size_t n) {
+        std::unique_lock<std::mutex> lock(mtx);
+        size_t inseridos = 0;
+        while (inseridos < n) {
+            while (buffer.size() == capacidade) {
+                ++contadores.esperas;
+                ++produtores_esperando;
+                cv_produtor.wait(lock);
+                --produtores_esperando;
+            }
+            inseridos += inserir_lote_sob_trava(itens + inseridos, n - inseridos);
+        }
+    }
+
+    // Espera haver pelo menos 1 item e retira ate 'maximo'; devolve quantos
+    size_t retirar_lote(Item* destino, size_t maximo) {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (buffer.empty()) {
+            ++contadores.esperas;
+            ++consumidores_esperando;
+            cv_consumidor.wait(lock);
+            --consumidores_esperando;
+        }
+        return retirar_lote_sob_trava(destino, maximo);
+    }
+
+    size_t tentar_inserir_lote(const Item* itens, size_t n) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return inserir_lote_sob_trava(itens, n);
+    }
+
+    size_t tentar_retirar_lote(Item* destino, size_t maximo) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return retirar_lote_sob_trava(destino, maximo);
+    }
+
+    size_t tamanho_maximo() const { return capacidade; }
+
+    ContadoresFila ler_contadores() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return contadores;
+    }
+
+private:
+    // Item a item: notifica sempre, como o original
+    void inserir_um_sob_trava(const Item& item) {
+        buffer.push_back(item);
+        contadores.notificacoes += consumidores_esperando > 0;
+        cv_consumidor.notify_one();
+    }
+
+    Item retirar_um_sob_trava() {
+        Item item = buffer.front();
+        buffer.erase(buffer.begin()); // O(n): desloca todos os itens restantes
+        contadores.notificacoes += produtores_esperando > 0;
+        cv_produtor.notify_one();
+        return item;
+    }
+
+    // Em lote: quantos couberem/houver, notificando so nas transicoes
+    size_t inserir_lote_sob_trava(const Item* itens, size_t n) {
+        bool estava_vazia = buffer.empty();
+        size_t k = std::min(n, capacidade - buffer.size());
+        buffer.insert(buffer.end(), itens, itens + k);
+        if (k > 0 && estava_vazia && consumidores_esperando > 0) {
+            ++contadores.notificacoes;
+            cv_consumidor.notify_all();
+        }
+        return k;
+    }
+
+    size_t retirar_lote_sob_trava(Item* destino, size_t maximo) {
+        bool estava_cheia = buffer.size() == capacidade;
+        size_t k = std::min(maximo, buffer.size());
+        std::copy(buffer.begin(), buffer.begin() + k, destino);
+        buffer.erase(buffer.begin(), buffer.begin() + k); // Um deslocamento por lote
+        if (k > 0 && estava_cheia && produtores_esperando > 0) {
+            ++contadores.notificacoes;
+            cv_produtor.notify_all();
+        }
+        return k;
+    }
+
+    std::vector<Item> buffer;
+    size_t capacidade;
+    std::mutex mtx;
+    std::condition_variable cv_produtor;
+    std::condition_variable cv_consumidor;
+    int produtores_esperando = 0;
+    int consumidores_esperando = 0;
+    ContadoresFila contadores = {0, 0}; // Protegidos por mtx
+};
+
+// Fila em anel sem travas para exatamente 1 produtor e 1 consumidor.
+// A capacidade e arredondada para potencia de 2, entao a posicao no anel e
+// so 'indice & mascara'. Cada indice so e escrito por uma thread:
+//   - cauda: escrita pelo produtor (release), lida pelo consumidor (acquire)
+//   - cabeca: escrita pelo consumidor (release), lida pelo produtor (acquire)
+// O release publica o item gravado no anel antes do novo indice.
+template <typename Espera = EsperaCedendo>
+class FilaAnelSPSC {
+public:
+    explicit FilaAnelSPSC(size_t capacidade_minima) {
+        capacidade = 1;
+        while (capacidade < capacidade_minima) {
+            capacidade <<= 1;
+        }
+        mascara = capacidade - 1;
+        anel.resize(capacidade);
+    }
+
+    // Nao bloqueiam: retornam false com a fila cheia/vazia
+    bool tentar_inserir(const Item& item) {
+        size_t posicao = cauda.load(std::memory_order_relaxed);
+        if (posicao - cabeca_vista_pelo_produtor == capacidade) {
+            // So rele o indice da outra thread quando a copia local diz "cheio"
+            cabeca_vista_pelo_produtor = cabeca.load(std::memory_order_acquire);
+            if (posicao - cabeca_vista_pelo_produtor == capacidade) {
+                return false;
+            }
+        }
+        anel[posicao & mascara] = item;
+        cauda.store(posicao + 1, std::memory_order_release);
+        espera_consumidor.avisar();
+        return true;
+    }
+
+    bool tentar_retirar(Item& item) {
+        size_t posicao = cabeca.load(std::memory_order_relaxed);
+        if (posicao == cauda_vista_pelo_consumidor) {
+            cauda_vista_pelo_consumidor = cauda.load(std::memory_order_acquire);
+            if (posicao == cauda_vista_pelo_consumidor) {
+                return false;
+            }
+        }
+        item = anel[posicao & mascara];
+        cabeca.store(posicao + 1, std::memory_order_release);
+        espera_produtor.avisar();
+        return true;
+    }
+
+    // Lotes: copia quantos couberem/houver e publica todos com um unico
+    // store do indice. Retornam quantos itens moveram (0 = cheia/vazia).
+    size_t tentar_inserir_lote(const Item* itens, size_t n) {
+        size_t posicao = cauda.load(std::memory_order_relaxed);
+        if (capacidade - (posicao - cabeca_vista_pelo_produtor) < n) {
+            cabeca_vista_pelo_produtor = cabeca.load(std::memory_order_acquire);
+        }
+        size_t k = std::min(n, capacidade - (posicao - cabeca_vista_pelo_produtor));
+        for (size_t i = 0; i < k; ++i) {
+            anel[(posicao + i) & mascara] = itens[i];
+        }
+        if (k > 0) {
+            cauda.store(posicao + k, std::memory_order_release);
+            espera_consumidor.avisar();
+        }
+        return k;
+    }
+
+    size_t tentar_retirar_lote(Item* destino, size_t maximo) {
+        size_t posicao = cabeca.load(std::memory_order_relaxed);
+        if (cauda_vista_pelo_consumidor - posicao < maximo) {
+            cauda_vista_pelo_consumidor = cauda.load(std::memory_order_acquire);
+        }
+        size_t k = std::min(maximo, cauda_vista_pelo_consumidor - posicao);
+        for (size_t i = 0; i < k; ++i) {
+            destino[i] = anel[(posicao + i) & mascara];
+        }
+        if (k > 0) {
+            cabeca.store(posicao + k, std::memory_order_release);
+            espera_produtor.avisar();
+        }
+        return k;
+    }
+
+    // Versoes bloqueantes: o que fazer com a fila cheia/vazia fica a cargo
+    // da estrategia de espera (por padrao, ceder o processador); as
+    // operacoes acima avisam o outro lado a cada movimento
+    void inserir(const Item& item) {
+        espera_produtor.esperar([&]() { return tentar_inserir(item); });
+    }
+
+    Item retirar() {
+        Item item;
+        espera_consumidor.esperar([&]() { return tentar_retirar(item); });
+        return item;
+    }
+
+    void inserir_lote(const Item* itens, size_t n) {
+        size_t inseridos = 0;
+        espera_produtor.esperar([&]() {
+            inseridos += tentar_inserir_lote(itens + inseridos, n - inseridos);
+            return inseridos == n;
+        });
+    }
+
+    size_t retirar_lote(Item* destino, size_t maximo) {
+        size_t k = 0;
+        espera_consumidor.esperar([&]() { return (k = tentar_retirar_lote(destino, maximo)) > 0; });
+        return k;
+    }
+
+    size_t tamanho_maximo() const { return capacidade; }
+
+    ContadoresFila ler_contadores() const {
+        return somar_contadores(espera_produtor.contadores(), espera_consumidor.contadores());
+    }
+
+private:
+    std::vector<Item> anel;
+    size_t capacidade;
+    size_t mascara;
+
+    // Lado do consumidor
+    alignas(LINHA_DE_CACHE) std::atomic<size_t> cabeca{0};
+    size_t cauda_vista_pelo_consumidor = 0;
+
+    // Lado do produtor
+    alignas(LINHA_DE_CACHE) std::atomic<size_t> cauda{0};
+    size_t cabeca_vista_pelo_produtor = 0;
+
+    // Cada lado espera na sua estrategia; o outro lado so le dela ao avisar
+    alignas(LINHA_DE_CACHE) Espera espera_produtor;
+    alignas(LINHA_DE_CACHE) Espera espera_consumidor;
+};
+
+// Fila limitada para varios produtores e varios consumidores, sem travas
+// (algoritmo de Dmitry Vyukov). Cada posicao do anel tem um numero de
+// sequencia que diz de quem e a vez:
+//   sequencia == posicao      -> livre para o produtor da volta 'posicao'
+//   sequencia == posicao + 1  -> ocupada, pronta para o consumidor
+// Produtores disputam 'pos_insercao' e consumidores 'pos_retirada' com um
+// compare_exchange; depois de reservar a posicao, cada um mexe so no seu
+// slot e o libera publicando a nova sequencia (release).
+template <typename Espera = EsperaCedendo>
+class FilaMPMC {
+public:
+    explicit FilaMPMC(size_t capacidade_minima) {
+        capacidade = 2; // Com 1 slot as duas sequencias se confundiriam
+        while (capacidade < capacidade_minima) {
+            capacidade <<= 1;
+        }
+        mascara = capacidade - 1;
+        slots = std::vector<Slot>(capacidade);
+        for (size_t i = 0; i < capacidade; ++i) {
+            slots[i].sequencia.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tentar_inserir(const Item& item) {
+        size_t posicao = pos_insercao.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[posicao & mascara];
+            size_t sequencia = slot.sequencia.load(std::memory_order_acquire);
+            intptr_t diferenca = static_cast<intptr_t>(sequencia) - static_cast<intptr_t>(posicao);
+            if (diferenca == 0) {
+                // Slot livre nesta volta: tenta reservar a posicao
+                if (pos_insercao.compare_exchange_weak(posicao, posicao + 1, std::memory_order_relaxed)) {
+                    slot.item = item;
+                    slot.sequencia.store(posicao + 1, std::memory_order_release);
+                    espera_consumidor.avisar();
+                    return true;
+                }
+                // Outro produtor levou: 'posicao' ja foi atualizada pelo CAS
+            } else if (diferenca < 0) {
+                return false; // O slot ainda guarda um item da volta anterior: cheia
+            } else {
+                posicao = pos_insercao.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tentar_retirar(Item& item) {
+        size_t posicao = pos_retirada.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[posicao & mascara];
+            size_t sequencia = slot.sequencia.load(std::memory_order_acquire);
+            intptr_t diferenca = static_cast<intptr_t>(sequencia) - static_cast<intptr_t>(posicao + 1);
+            if (diferenca == 0) {
+                if (pos_retirada.compare_exchange_weak(posicao, posicao + 1, std::memory_order_relaxed)) {
+                    item = slot.item;
+                    // Libera o slot para o produtor da proxima volta
+                    slot.sequencia.store(posicao + capacidade, std::memory_order_release);
+                    espera_produtor.avisar();
+                    return true;
+                }
+            } else if (diferenca < 0) {
+                return false; // Vazia
+            } else {
+                posicao = pos_retirada.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Lotes: conta quantos slots seguidos a partir da posicao atual estao
+    // prontos e reserva todos com um unico compare_exchange. Os slots
+    // conferidos nao mudam de estado sem que alguem reserve as posicoes
+    // antes, entao um CAS bem-sucedido garante todos eles.
+    size_t tentar_inserir_lote(const Item* itens, size_t n) {
+        size_t posicao = pos_insercao.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t k = 0;
+            while (k < n && slots[(posicao + k) & mascara].sequencia.load(std::memory_order_acquire) == posicao + k) {
+                ++k;
+            }
+            if (k == 0) {
+                size_t sequencia = slots[posicao & mascara].sequencia.load(std::memory_order_acquire);
+                if (static_cast<intptr_t>(sequencia) - static_cast<intptr_t>(posicao) < 0) {
+                    return 0; // Cheia
+                }
+                posicao = pos_insercao.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (pos_insercao.compare_exchange_weak(posicao, posicao + k, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < k; ++i) {
+                    Slot& slot = slots[(posicao + i) & mascara];
+                    slot.item = itens[i];
+                    slot.sequencia.store(posicao + i + 1, std::memory_order_release);
+                }
+                espera_consumidor.avisar();
+                return k;
+            }
+        }
+    }
+
+    size_t tentar_retirar_lote(Item* destino, size_t maximo) {
+        size_t posicao = pos_retirada.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t k = 0;
+            while (k < maximo &&
+                   slots[(posicao + k) & mascara].sequencia.load(std::memory_order_acquire) == posicao + k + 1) {
+                ++k;
+            }
+            if (k == 0) {
+                size_t sequencia = slots[posicao & mascara].sequencia.load(std::memory_order_acquire);
+                if (static_cast<intptr_t>(sequencia) - static_cast<intptr_t>(posicao + 1) < 0) {
+                    return 0; // Vazia
+                }
+                posicao = pos_retirada.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (pos_retirada.compare_exchange_weak(posicao, posicao + k, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < k; ++i) {
+                    Slot& slot = slots[(posicao + i) & mascara];
+                    destino[i] = slot.item;
+                    slot.sequencia.store(posicao + i + capacidade, std::memory_order_release);
+                }
+                espera_produtor.avisar();
+                return k;
+            }
+        }
+    }
+
+    void inserir(const Item& item) {
+        espera_produtor.esperar([&]() { return tentar_inserir(item); });
+    }
+
+    Item retirar() {
+        Item item;
+        espera_consumidor.esperar([&]() { return tentar_retirar(item); });
+        return item;
+    }
+
+    void inserir_lote(const Item* itens, size_t n) {
+        size_t inseridos = 0;
+        espera_produtor.esperar([&]() {
+            inseridos += tentar_inserir_lote(itens + inseridos, n - inseridos);
+            return inseridos == n;
+        });
+    }
+
+    size_t retirar_lote(Item* destino, size_t maximo) {
+        size_t k = 0;
+        espera_consumidor.esperar([&]() { return (k = tentar_retirar_lote(destino, maximo)) > 0; });
+        return k;
+    }
+
+    size_t tamanho_maximo() const { return capacidade; }
+
+    ContadoresFila ler_contadores() const {
+        return somar_contadores(espera_produtor.contadores(), espera_consumidor.contadores());
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequencia;
+        Item item;
+    };
+
+    std::vector<Slot> slots;
+    size_t capacidade;
+    size_t mascara;
+    alignas(LINHA_DE_CACHE) std::atomic<size_t> pos_insercao{0}; // Disputada pelos produtores
+    alignas(LINHA_DE_CACHE) std::atomic<size_t> pos_retirada{0}; // Disputada pelos consumidores
+    alignas(LINHA_DE_CACHE) Espera espera_produtor;
+    alignas(LINHA_DE_CACHE) Espera espera_consumidor;
+};
+
+// === BENCHMARK DE VAZAO ===
+// Item especial que manda o consumidor parar ("pilula de veneno"). Os itens
+// reais sao 1..total, entao 0 nunca aparece como dado.
+const int VALOR_FIM = 0;
+const Item ITEM_FIM = {VALOR_FIM, 0};
+
+// Maior lote aceito (tamanho dos vetores locais de produtor e consumidor)
+const size_t LOTE_MAXIMO = 4096;
+
+// Configuracao de uma execucao: quantos produtores/consumidores, capacidade
+// da fila, total de itens (divididos entre os produtores) e o tamanho do
+// lote (1 = item a item, com inserir/retirar)
+struct ConfiguracaoExecucao {
+    int produtores;
+    int consumidores;
+    size_t capacidade;
+    long total_itens;
+    size_t lote;
+    bool adaptativo; // Consumidor comeca com lote 1 e dobra enquanto houver fila
+    bool medir_latencia;
+};
+
+struct ResultadoVazao {
+    double itens_por_segundo; // 0 se a verificacao dos itens falhar
+    double cpu_ns_por_item;   // Tempo de processador de todas as threads
+    double nucleos_ocupados;  // Tempo de processador / tempo decorrido
+    ContadoresFila contadores;
+    ResumoLatencia latencia;     // Da insercao a retirada de cada item
+    ResumoLatencia espera_cheia; // Produtores bloqueados com a fila cheia
+    ResumoLatencia espera_vazia; // Consumidores bloqueados com a fila vazia
+};
+
+// Tempo de processador ja gasto pelo processo (todas as threads), em s.
+// Quem gira gasta processador mesmo sem mover itens; quem dorme, nao.
+double tempo_de_cpu() {
+#ifdef _WIN32
+    FILETIME criacao, saida, nucleo, usuario;
+    GetProcessTimes(GetCurrentProcess(), &criacao, &saida, &nucleo, &usuario);
+    auto em_segundos = [](const FILETIME& t) {
+        return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7; // Unidades de 100 ns
+    };
+    return em_segundos(nucleo) + em_segundos(usuario);
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC; // No POSIX, clock() e tempo de processador
+#endif
+}
+
+// Tamanho de lote que cresce enquanto ha fila acumulada (o consumidor
+// recebeu o lote cheio) e encolhe quando a fila esvazia, entre 1 e 'maximo'
+struct LoteAdaptativo {
+    size_t atual;
+    size_t maximo;
+
+    void ajustar(size_t obtidos) {
+        if (obtidos == atual && atual < maximo) {
+            atual = std::min(maximo, atual * 2);
+        } else if (obtidos < atual / 2) {
+            atual = std::max<size_t>(1, atual / 2);
+        }
+    }
+};
+
+// Os produtores inserem os itens 1..total (cada um uma faixa contigua).
+// Quando todos terminam, a thread principal insere uma pilula por
+// consumidor; cada consumidor para na primeira pilula que retirar, sem
+// precisar saber quantos itens existem. Cada consumidor confere que os
+// itens de um mesmo produtor chegam em ordem crescente (FIFO) e, no fim,
+// a contagem e a soma de tudo que foi consumido.
+// Com medir_latencia, cada item sai do produtor carimbado com o relogio
+// (um carimbo por lote) e o consumidor registra quanto tempo ele levou ate
+// ser retirado, com uma leitura do relogio por retirada; a latencia inclui
+// a espera do produtor por espaco. Produtor e consumidor tentam primeiro
+// sem esperar e so cronometram a espera quando a fila esta cheia/vazia.
+// Cada thread tem seus histogramas; a soma e feita depois dos join().
+template <typename Fila>
+ResultadoVazao medir_vazao(const ConfiguracaoExecucao& config) {
+    Fila fila(config.capacidade);
+    long por_produtor = (config.total_itens + config.produtores - 1) / config.produtores;
+    std::atomic<long long> soma_consumida{0};
+    std::atomic<long> itens_consumidos{0};
+    std::atomic<bool> ordem_correta{true};
+    std::vector<HistogramaLatencia> latencias(config.consumidores);
+    std::vector<HistogramaLatencia> esperas_vazia(config.consumidores);
+    std::vector<HistogramaLatencia> esperas_cheia(config.produtores);
+
+    auto inicio = std::chrono::steady_clock::now();
+    double cpu_inicio = tempo_de_cpu();
+
+    std::vector<std::thread> consumidores;
+    for (int c = 0; c < config.consumidores; ++c) {
+        consumidores.emplace_back([&, c]() {
+            std::vector<int> ultimo_de_cada_produtor(config.produtores, 0);
+            std::vector<Item> recebidos(config.lote);
+            LoteAdaptativo lote = {config.adaptativo ? 1 : config.lote, config.lote};
+            long long soma = 0;
+            long contagem = 0;
+            bool fim = false;
+            while (!fim) {
+                size_t obtidos;
+                int64_t retirada_ns = 0;
+                if (!config.medir_latencia) {
+                    if (config.lote == 1) {
+                        recebidos[0] = fila.retirar();
+                        obtidos = 1;
+                    } else {
+                        obtidos = fila.retirar_lote(recebidos.data(), lote.atual);
+                    }
+                } else {
+                    obtidos = config.lote == 1 ? fila.tentar_retirar(recebidos[0])
+                                               : fila.tentar_retirar_lote(recebidos.data(), lote.atual);
+                    if (obtidos == 0) {
+                        int64_t espera_ns = agora_ns();
+                        if (config.lote == 1) {
+                            recebidos[0] = fila.retirar();
+                            obtidos = 1;
+                        } else {
+                            obtidos = fila.retirar_lote(recebidos.data(), lote.atual);
+                        }
+                        retirada_ns = agora_ns();
+                        esperas_vazia[c].registrar(retirada_ns - espera_ns);
+                    } else {
+                        retirada_ns = agora_ns();
+                    }
+                }
+                if (config.adaptativo) {
+                    lote.ajustar(obtidos);
+                }
+                for (size_t i = 0; i < obtidos; ++i) {
+                    const Item& item = recebidos[i];
+                    if (item.valor == VALOR_FIM) {
+                        // As pilulas vem depois de todos os itens; as que
+                        // vieram a mais neste lote voltam para os outros
+                        for (size_t j = i + 1; j < obtidos; ++j) {
+                            fila.inserir(recebidos[j]);
+                        }
+                        fim = true;
+                        break;
+                    }
+                    if (config.medir_latencia) {
+                        latencias[c].registrar(retirada_ns - item.enfileirado_ns);
+                    }
+                    int& ultimo = ultimo_de_cada_produtor[(item.valor - 1) / por_produtor];
+                    if (item.valor <= ultimo) {
+                        ordem_correta = false;
+                    }
+                    ultimo = item.valor;
+                    soma += item.valor;
+                    ++contagem;
+                }
+            }
+            soma_consumida += soma;
+            itens_consumidos += contagem;
+        });
+    }
+
+    std::vector<std::thread> produtores;
+    for (int p = 0; p < config.produtores; ++p) {
+        produtores.emplace_back([&, p]() {
+            long primeiro = p * por_produtor + 1;
+            long ultimo = std::min(config.total_itens, primeiro + por_produtor - 1);
+            std::vector<Item> lote(config.lote);
+            for (long i = primeiro; i <= ultimo; ) {
+                int64_t carimbo = config.medir_latencia ? agora_ns() : 0;
+                size_t n = 0;
+                while (n < config.lote && i <= ultimo) {
+                    lote[n++] = {static_cast<int>(i++), carimbo};
+                }
+                if (!config.medir_latencia) {
+                    if (config.lote == 1) {
+                        fila.inserir(lote[0]);
+                    } else {
+                        fila.inserir_lote(lote.data(), n);
+                    }
+                    continue;
+                }
+                size_t inseridos = config.lote == 1 ? fila.tentar_inserir(lote[0])
+                                                    : fila.tentar_inserir_lote(lote.data(), n);
+                if (inseridos < n) {
+                    int64_t espera_ns = agora_ns();
+                    if (config.lote == 1) {
+                        fila.inserir(lote[0]);
+                    } else {
+                        fila.inserir_lote(lote.data() + inseridos, n - inseridos);
+                    }
+                    esperas_cheia[p].registrar(agora_ns() - espera_ns);
+                }
+            }
+        });
+    }
+    for (auto& t : produtores) {
+        t.join();
+    }
+    for (int c = 0; c < config.consumidores; ++c) {
+        fila.inserir(ITEM_FIM);
+    }
+    for (auto& t : consumidores) {
+        t.join();
+    }
+
+    std::chrono::duration<double> segundos = std::chrono::steady_clock::now() - inicio;
+    double segundos_de_cpu = tempo_de_cpu() - cpu_inicio;
+    long long soma_esperada = static_cast<long long>(config.total_itens) * (config.total_itens + 1) / 2;
+    bool correto = ordem_correta && itens_consumidos == config.total_itens && soma_consumida == soma_esperada;
+    for (size_t i = 1; i < latencias.size(); ++i) {
+        latencias[0].acumular(latencias[i]);
+        esperas_vazia[0].acumular(esperas_vazia[i]);
+    }
+    for (size_t i = 1; i < esperas_cheia.size(); ++i) {
+        esperas_cheia[0].acumular(esperas_cheia[i]);
+    }
+    return {correto ? config.total_itens / segundos.count() : 0.0, segundos_de_cpu * 1e9 / config.total_itens,
+            segundos_de_cpu / segundos.count(), fila.ler_contadores(), latencias[0].resumir(),
+            esperas_cheia[0].resumir(), esperas_vazia[0].resumir()};
+}
+
+// A execucao mediana (pela vazao) de algumas repeticoes; a primeira tambem
+// aquece caches e threads
+template <typename Fila>
+ResultadoVazao mediana_da_vazao(const ConfiguracaoExecucao& config, int repeticoes) {
+    std::vector<ResultadoVazao> resultados;
+    for (int r = 0; r < repeticoes; ++r) {
+        resultados.push_back(medir_vazao<Fila>(config));
+    }
+    std::sort(resultados.begin(), resultados.end(), [](const ResultadoVazao& a, const ResultadoVazao& b) {
+        return a.itens_por_segundo < b.itens_por_segundo;
+    });
+    return resultados[resultados.size() / 2];
+}
+
+// Uma linha da tabela; devolve false se a verificacao dos itens falhou
+static bool exibir_vazao(const char* nome, const ConfiguracaoExecucao& config, const ResultadoVazao& resultado,
+                         double referencia) {
+    std::string modo = config.lote == 1 ? "item a item"
+                                        : (config.adaptativo ? "lote <= " : "lote ") + std::to_string(config.lote);
+    std::printf(" %dP/%dC  %-18s  %-15s : %12.0f itens/s | notif/item %.4f | esperas/item %.4f"
+                " | cpu %7.1f ns/item (%.2f nucleos)",
+                config.produtores, config.consumidores, nome, modo.c_str(), resultado.itens_por_segundo,
+                static_cast<double>(resultado.contadores.notificacoes) / config.total_itens,
+                static_cast<double>(resultado.contadores.esperas) / config.total_itens, resultado.cpu_ns_por_item,
+                resultado.nucleos_ocupados);
+    if (referencia > 0 && resultado.itens_por_segundo > 0) {
+        std::printf(" (%.2fx a primeira linha)", resultado.itens_por_segundo / referencia);
+    }
+    std::printf("\n");
+    if (config.medir_latencia) {
+        exibir_latencia("latencia insercao->retirada", resultado.latencia);
+        exibir_latencia("produtor esperando (cheia)", resultado.espera_cheia);
+        exibir_latencia("consumidor esperando (vazia)", resultado.espera_vazia);
+    }
+    std::fflush(stdout);
+    if (resultado.itens_por_segundo == 0) {
+        std::cerr << "ERRO: itens perdidos, repetidos ou fora de ordem na fila " << nome << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Mede uma fila item a item e, se pedido, tambem em lotes
+template <typename Fila>
+static bool medir_fila(const char* nome, const ConfiguracaoExecucao& execucao, int repeticoes,
+                       double& referencia) {
+    ConfiguracaoExecucao item_a_item = execucao;
+    item_a_item.lote = 1;
+    item_a_item.adaptativo = false;
+    ResultadoVazao resultado = mediana_da_vazao<Fila>(item_a_item, repeticoes);
+    if (referencia == 0) {
+        referencia = resultado.itens_por_segundo; // A primeira medida e a referencia
+    }
+    bool correto = exibir_vazao(nome, item_a_item, resultado, referencia);
+    if (execucao.lote > 1) {
+        correto = exibir_vazao(nome, execucao, mediana_da_vazao<Fila>(execucao, repeticoes), referencia) && correto;
+    }
+    return correto;
+}
+
+// Mede as filas sem travas pedidas com uma estrategia de espera
+template <typename Espera>
+static bool medir_com_espera(const std::string& fila, const std::string& nome_espera,
+                             const ConfiguracaoExecucao& execucao, int repeticoes, double& referencia) {
+    bool correto = true;
+    if ((fila == "anel" || fila == "todas") && execucao.produtores == 1 && execucao.consumidores == 1) {
+        correto = medir_fila<FilaAnelSPSC<Espera>>(("anel " + nome_espera).c_str(), execucao, repeticoes,
+                                                   referencia) && correto;
+    }
+    if (fila == "mpmc" || fila == "todas") {
+        correto = medir_fila<FilaMPMC<Espera>>(("mpmc " + nome_espera).c_str(), execucao, repeticoes,
+                                               referencia) && correto;
+    }
+    return correto;
+}
+
+static bool medir_estrategias(const std::string& fila, const std::string& espera,
+                              const ConfiguracaoExecucao& execucao, int repeticoes) {
+    double referencia = 0;
+    bool correto = true;
+    if (fila == "mutex" || fila == "todas") {
+        correto = medir_fila<FilaMutex>("mutex + condvar", execucao, repeticoes, referencia) && correto;
+    }
+    auto pedida = [&espera](const char* nome) { return espera == "todas" || espera == nome; };
+    if (pedida("bloqueante")) {
+        correto = medir_com_espera<EsperaBloqueante>(fila, "bloqueante", execucao, repeticoes, referencia) && correto;
+    }
+    if (pedida("giro")) {
+        correto = medir_com_espera<EsperaGirando>(fila, "giro", execucao, repeticoes, referencia) && correto;
+    }
+    if (pedida("giro+cede")) {
+        correto = medir_com_espera<EsperaGiraDepoisCede>(fila, "giro+cede", execucao, repeticoes, referencia) &&
+                  correto;
+    }
+    if (pedida("giro+dorme")) {
+        correto = medir_com_espera<EsperaGiraDorme>(fila, "giro+dorme", execucao, repeticoes, referencia) && correto;
+    }
+    if (pedida("adaptativa")) {
+        correto = medir_com_espera<EsperaAdaptativa>(fila, "adaptativa", execucao, repeticoes, referencia) && correto;
+    }
+    return correto;
+}
+
+// ProdutorConsumidor --benchmark [--fila mutex|anel|mpmc|todas]
+//     [--produtores N] [--consumidores N] [--capacidade N] [--itens N]
+//     [--lote K] [--adaptativo] [--repeticoes N] [--escala] [--latencia]
+//     [--espera bloqueante|giro|giro+cede|giro+dorme|adaptativa|todas]
+// Com --lote K (> 1) cada fila tambem e medida movendo ate K itens por
+// travamento/reserva; --adaptativo faz o consumidor crescer o lote de 1 ate
+// K enquanto houver fila acumulada. Com --escala mede de 2 threads ate
+// hardware_concurrency (metade produtores, metade consumidores). Com
+// --latencia cada linha tambem traz os percentis da latencia dos itens e
+// das esperas (cada execucao e a mediana pela vazao; seus percentis vao
+// juntos). Serve para escolher a capacidade olhando a cauda da latencia.
+// Com --espera as filas sem travas sao medidas com cada estrategia de
+// espera (ja com --latencia), ao lado do mutex como referencia: vazao,
+// latencia e processador gasto por item, para decidir entre ocupar
+// nucleos girando e pagar a latencia de dormir.
+int executar_benchmark(int argc, char* argv[]) {
+    std::string fila = "todas";
+    std::string espera;
+    ConfiguracaoExecucao config = {1, 1, 1024, 10000000, 1, false, false};
+    int repeticoes = 3;
+    bool escala = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string opcao = argv[i];
+        if (opcao == "--escala") {
+            escala = true;
+            continue;
+        }
+        if (opcao == "--adaptativo") {
+            config.adaptativo = true;
+            continue;
+        }
+        if (opcao == "--latencia") {
+            config.medir_latencia = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Falta o valor de " << opcao << "\n";
+            return 1;
+        }
+        const char* valor = argv[++i];
+        if (opcao == "--fila") {
+            fila = valor;
+        } else if (opcao == "--espera") {
+            espera = valor;
+            config.medir_latencia = true;
+        } else if (opcao == "--produtores") {
+            config.produtores = std::max(1, std::atoi(valor));
+        } else if (opcao == "--consumidores") {
+            config.consumidores = std::max(1, std::atoi(valor));
+        } else if (opcao == "--itens") {
+            config.total_itens = std::max(1L, std::atol(valor));
+        } else if (opcao == "--capacidade") {
+            config.capacidade = static_cast<size_t>(std::max(1L, std::atol(valor)));
+        } else if (opcao == "--lote") {
+            config.lote = std::min(LOTE_MAXIMO, static_cast<size_t>(std::max(1L, std::atol(valor))));
+        } else if (opcao == "--repeticoes") {
+            repeticoes = std::max(1, std::atoi(valor));
+        } else {
+            std::cerr << "Opcao desconhecida: " << opcao << "\n";
+            return 1;
+        }
+    }
+    if (fila != "mutex" && fila != "anel" && fila != "mpmc" && fila != "todas") {
+        std::cerr << "Fila invalida: " << fila << " (mutex, anel, mpmc ou todas)\n";
+        return 1;
+    }
+    const char* estrategias[] = {"bloqueante", "giro", "giro+cede", "giro+dorme", "adaptativa"};
+    if (!espera.empty() && espera != "todas" && std::find(std::begin(estrategias), std::end(estrategias), espera) ==
+                                                    std::end(estrategias)) {
+        std::cerr << "Espera invalida: " << espera << " (bloqueante, giro, giro+cede, giro+dorme, adaptativa ou todas)\n";
+        return 1;
+    }
+    bool um_para_um = config.produtores == 1 && config.consumidores == 1;
+    if (fila == "anel" && (!um_para_um || escala)) {
+        std::cerr << "A fila em anel so admite 1 produtor e 1 consumidor.\n";
+        return 1;
+    }
+    if (config.adaptativo && config.lote == 1) {
+        config.lote = 256; // Teto padrao do lote adaptativo
+    }
+
+    std::cout << "========================================================\n";
+    std::cout << " BENCHMARK DE VAZAO DAS FILAS\n";
+    std::cout << " Capacidade: " << config.capacidade << " | Itens: " << config.total_itens
+              << " | Mediana de " << repeticoes << " execucoes\n";
+    std::cout << "========================================================\n";
+
+    // Configuracoes medidas: a pedida, ou a curva de escala
+    std::vector<ConfiguracaoExecucao> execucoes;
+    if (escala) {
+        int nucleos = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+        for (int threads = 2; threads <= nucleos; threads += 2) {
+            ConfiguracaoExecucao execucao = config;
+            execucao.produtores = execucao.consumidores = threads / 2;
+            execucoes.push_back(execucao);
+        }
+    } else {
+        execucoes.push_back(config);
+    }
+
+    bool correto = true;
+    if (!espera.empty()) {
+        for (const auto& execucao : execucoes) {
+            correto = medir_estrategias(fila, espera, execucao, repeticoes) && correto;
+        }
+        return correto ? 0 : 1;
+    }
+    for (const auto& execucao : execucoes) {
+        double referencia = 0;
+        if (fila == "mutex" || fila == "todas") {
+            correto = medir_fila<FilaMutex>("mutex + condvar", execucao, repeticoes, referencia) && correto;
+        }
+        if ((fila == "anel" || fila == "todas") && execucao.produtores == 1 && execucao.consumidores == 1) {
+            correto = medir_fila<FilaAnelSPSC<>>("anel SPSC", execucao, repeticoes, referencia) && correto;
+        }
+        if (fila == "mpmc" || fila == "todas") {
+            correto = medir_fila<FilaMPMC<>>("MPMC sem travas", execucao, repeticoes, referencia) && correto;
+        }
+    }
+    return correto ? 0 : 1;
+}
+
+// === BENCHMARK DE MENSAGENS (FILA GENERICA) ===
+// Contador de alocacoes no heap do programa inteiro: substitui o operator
+// new global (new[] e new(nothrow) do padrao passam por ele).
+std::atomic<long long> alocacoes_no_heap{0};
+
+void* operator new(std::size_t tamanho) {
+    alocacoes_no_heap.fetch_add(1, std::memory_order_relaxed);
+    if (void* memoria = std::malloc(tamanho == 0 ? 1 : tamanho)) {
+        return memoria;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memoria) noexcept { std::free(memoria); }
+void operator delete(void* memoria, std::size_t) noexcept { std::free(memoria); }
+
+// Mensagem grande e so-movivel, como as do sistema real: 4 KB com a carga
+// dentro do proprio objeto. Sem construtor de copia, a fila so compila se
+// nunca copiar; a marca no inicio e no fim da carga confere que a mensagem
+// chegou inteira.
+const size_t TAMANHO_MENSAGEM = 4096;
+
+struct Mensagem {
+    long sequencia;
+    int produtor;
+    unsigned char carga[TAMANHO_MENSAGEM - sizeof(long) - sizeof(int)];
+
+    Mensagem() = default;
+    Mensagem(int produtor, long sequencia) : sequencia(sequencia), produtor(produtor) {
+        carga[0] = static_cast<unsigned char>(sequencia);
+        carga[sizeof(carga) - 1] = static_cast<unsigned char>(sequencia >> 8);
+    }
+    Mensagem(const Mensagem&) = delete;
+    Mensagem& operator=(const Mensagem&) = delete;
+    Mensagem(Mensagem&&) = default;
+    Mensagem& operator=(Mensagem&&) = default;
+
+    bool integra() const {
+        return carga[0] == static_cast<unsigned char>(sequencia) &&
+               carga[sizeof(carga) - 1] == static_cast<unsigned char>(sequencia >> 8);
+    }
+};
+
+static_assert(sizeof(Mensagem) == TAMANHO_MENSAGEM, "Mensagem deve ocupar exatamente 4 KB");
+
+const size_t CAPACIDADE_MENSAGENS = 64;
+typedef FilaLimitada<Mensagem, CAPACIDADE_MENSAGENS> FilaDeMensagens;
+
+// ProdutorConsumidor --mensagens [--produtores N] [--consumidores N] [--itens N]
+// Os produtores constroem cada mensagem direto no slot da fila
+// (inserir_no_lugar); os consumidores a movem para uma variavel local
+// reaproveitada. Quando os produtores terminam, a fila e fechada e os
+// consumidores saem ao esvazia-la. As alocacoes sao contadas entre 10% e
+// 90% das mensagens consumidas (o regime: threads e fila ja criadas).
+int executar_benchmark_mensagens(int argc, char* argv[]) {
+    int num_produtores = 1;
+    int num_consumidores = 1;
+    long total = 1000000;
+    for (int i = 2; i < argc; ++i) {
+        std::string opcao = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Falta o valor de " << opcao << "\n";
+            return 1;
+        }
+        const char* valor = argv[++i];
+        if (opcao == "--produtores") {
+            num_produtores = std::max(1, std::atoi(valor));
+        } else if (opcao == "--consumidores") {
+            num_consumidores = std::max(1, std::atoi(valor));
+        } else if (opcao == "--itens") {
+            total = std::max(10L, std::atol(valor));
+        } else {
+            std::cerr << "Opcao desconhecida: " << opcao << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "========================================================\n";
+    std::cout << " BENCHMARK DA FILA GENERICA COM MENSAGENS SO-MOVIVEIS\n";
+    std::cout << " Mensagem: " << sizeof(Mensagem) << " bytes | Capacidade: " << FilaDeMensagens::capacidade()
+              << " | Mensagens: " << total << "\n";
+    std::cout << "========================================================\n";
+
+    // Os slots ficam dentro do objeto (256 KB): no heap, alocado uma vez
+    auto fila = std::make_unique<FilaDeMensagens>();
+    long por_produtor = (total + num_produtores - 1) / num_produtores;
+    long inicio_regime = total / 10;
+    long fim_regime = total - total / 10;
+    std::atomic<long> consumidas{0};
+    std::atomic<long long> alocacoes_inicio{0};
+    std::atomic<long long> alocacoes_fim{0};
+    std::atomic<bool> correto{true};
+
+    auto inicio = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> consumidores;
+    for (int c = 0; c < num_consumidores; ++c) {
+        consumidores.emplace_back([&]() {
+            std::vector<long> ultima_de_cada_produtor(num_produtores, -1);
+            Mensagem mensagem;
+            while (fila->retirar(mensagem)) {
+                long& ultima = ultima_de_cada_produtor[mensagem.produtor];
+                if (!mensagem.integra() || mensagem.sequencia <= ultima) {
+                    correto = false;
+                }
+                ultima = mensagem.sequencia;
+                long n = consumidas.fetch_add(1, std::memory_order_relaxed) + 1;
+                if (n == inicio_regime) {
+                    alocacoes_inicio = alocacoes_no_heap.load();
+                } else if (n == fim_regime) {
+                    alocacoes_fim = alocacoes_no_heap.load();
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> produtores;
+    for (int p = 0; p < num_produtores; ++p) {
+        produtores.emplace_back([&, p]() {
+            long primeira = p * por_produtor;
+            long ultima = std::min(total, primeira + por_produtor);
+            for (long i = primeira; i < ultima; ++i) {
+                fila->inserir_no_lugar(p, i);
+            }
+        });
+    }
+    for (auto& t : produtores) {
+        t.join();
+    }
+    fila->fechar();
+    for (auto& t : consumidores) {
+        t.join();
+    }
+
+    std::chrono::duration<double> segundos = std::chrono::steady_clock::now() - inicio;
+    long long alocacoes = alocacoes_fim - alocacoes_inicio;
+    std::printf(" %dP/%dC : %10.0f mensagens/s (%.0f MB/s) | alocacoes no regime: %lld (%.4f por mensagem)\n",
+                num_produtores, num_consumidores, total / segundos.count(),
+                total * sizeof(Mensagem) / segundos.count() / (1024.0 * 1024.0), alocacoes,
+                static_cast<double>(alocacoes) / (fim_regime - inicio_regime));
+    if (!correto || consumidas != total) {
+        std::cerr << "ERRO: mensagens perdidas, corrompidas ou fora de ordem.\n";
+        return 1;
+    }
+    if (alocacoes != 0) {
+        std::cerr << "ERRO: houve alocacao no heap durante o regime.\n";
+        return 1;
+    }
+    return 0;
+}
+
 // === FUNCAO PRINCIPAL ===
-int main() {
+// Sem argumentos roda a simulacao didatica; com --benchmark mede as filas e
+// com --mensagens mede a fila generica.
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::string(argv[1]) == "--benchmark") {
+        return executar_benchmark(argc, argv);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--mensagens") {
+        return executar_benchmark_mensagens(argc, argv);
+    }
+    modo_silencioso = argc >= 2 && std::string(argv[1]) == "--silencioso";
+
     std::cout << "========================================================\n";
     std::cout << " SIMULACAO: PROBLEMA DO PRODUTOR-CONSUMIDOR EM C++\n";
     std::cout << " Tamanho do Buffer: " << TAMANHO_BUFFER << " | Total de Itens: " << MAX_ITENS << "\n";
@@ -102,6 +1555,9 @@ int main() {
     std::cout << "\n========================================================\n";
     std::cout << " Sincronizacao concluida. Todos os itens foram processados.\n";
     std::cout << "========================================================\n";
+    exibir_latencia("latencia push_back->retirada", latencia_itens.resumir());
+    exibir_latencia("produtor esperando (cheio)", espera_produtor.resumir());
+    exibir_latencia("consumidor esperando (vazio)", espera_consumidor.resumir());
 
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file